@@ -823,6 +823,82 @@ BYTE apu_read(WORD address)
     }
 }
 
+/*
+* 计时器成批推进 count 次, 结果和逐次调用 update_*_timer 完全相同:
+* 先把当前的值数到 0, 再数一次重新装载, 之后每 period + 1 次装载一次. 返回装载的次数.
+*/
+static inline uint32_t advance_timer(uint32_t *timer, uint32_t period, uint32_t count)
+{
+    if (count <= *timer) {
+        *timer -= count;
+        return 0;
+    }
+
+    count -= *timer + 1;
+    *timer = period - count % (period + 1);
+
+    return count / (period + 1) + 1;
+}
+
+static void run_pulse_timer(PULSE_CHANNEL *pulse, uint32_t count)
+{
+    uint32_t timer = pulse->timer;
+    uint32_t reloads = advance_timer(&timer, pulse->timer_period, count);
+
+    pulse->timer = timer;
+    pulse->duty_step = (pulse->duty_step + reloads) & 7;
+}
+
+static void run_triangle_timer(uint32_t count)
+{
+    TRIANGLE_CHANNEL *triangle = &triangle1;
+
+    if (triangle->length_counter == 0 || triangle->linear_counter == 0) {
+        return;
+    }
+
+    uint32_t timer = triangle->timer;
+    uint32_t reloads = advance_timer(&timer, triangle->timer_period, count);
+
+    triangle->timer = timer;
+    triangle->step = (triangle->step + reloads) & 31;
+}
+
+static void run_noise_timer(uint32_t count)
+{
+    NOISE_CHANNEL *noise = &noise1;
+
+    // timer 只有 8 位, 装载的是截断后的周期
+    uint32_t timer = noise->timer;
+    uint32_t reloads = advance_timer(&timer, (uint8_t)noise->period, count);
+
+    noise->timer = timer;
+    while (reloads--) {
+        update_noise_shift_register(noise);
+    }
+}
+
+/*
+* 推进 [start_cycle, end_cycle) 这些 cpu 周期里的计时器:
+* 三角波每个 cpu 周期更新一次, 方波和噪音在偶数周期更新.
+* 这段时间里不会有写寄存器和帧序列器的步进, 三角波的开关状态不会改变.
+*/
+void run_apu_timers(uint64_t start_cycle, uint64_t end_cycle)
+{
+    if (end_cycle <= start_cycle) {
+        return;
+    }
+
+    run_triangle_timer(end_cycle - start_cycle);
+
+    uint32_t even_cycles = (end_cycle + 1) / 2 - (start_cycle + 1) / 2;
+    if (even_cycles) {
+        run_pulse_timer(&pulses[0], even_cycles);
+        run_pulse_timer(&pulses[1], even_cycles);
+        run_noise_timer(even_cycles);
+    }
+}
+
 void apu_init()
 {
     // 初始化脉冲波通道1
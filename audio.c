@@ -8,11 +8,11 @@ SDL_AudioDeviceID audio_device;
 
 static void submit_audio_buffer()
 {
-    if (audio_device == 0 || sample_buffer_index == 0) {
-        return;
+    // 没有打开音频设备时(例如不带窗口的工具) 直接丢掉, 否则缓冲区会写越界
+    if (audio_device != 0 && sample_buffer_index != 0) {
+        SDL_QueueAudio(audio_device, sample_buffer, sample_buffer_index * sizeof(sample_buffer[0]));
     }
 
-    SDL_QueueAudio(audio_device, sample_buffer, sample_buffer_index * sizeof(sample_buffer[0]));
     sample_buffer_index = 0;
 }
 
@@ -0,0 +1,190 @@
+#include "cdl.h"
+#include "memory.h"
+
+/*
+* PRG 按 mapper 映射之后的物理偏移记录, 执行的代码在取指时记录, 命中预解码缓存时按表项的位置直接得到偏移.
+* 打开以后 PRG-ROM 的读页表不再填写, 数据读取都走总线的慢路径, 在那里记录; 没有打开时不会有任何开销.
+* 跨 8KB 窗口不走预解码缓存的指令, 取指时也会经过总线, 已经记为代码的字节不再记为数据.
+* CHR 在 ppu 取背景和精灵的图案时记录, 图案有缓存, 每个缓存项只记一次. CHR-RAM 不记录
+*/
+BYTE cdl_enabled = 0;
+
+static BYTE *cdl_prg = NULL;
+static size_t cdl_prg_size = 0;
+static BYTE *cdl_chr = NULL;
+static size_t cdl_chr_size = 0;
+static char cdl_path[1024];
+
+// rom 的扩展名换成 .cdl
+static void make_cdl_path(const char *rom_path)
+{
+    snprintf(cdl_path, sizeof(cdl_path), "%s", rom_path);
+
+    char *dot = strrchr(cdl_path, '.');
+    char *slash = strrchr(cdl_path, '/');
+    char *backslash = strrchr(cdl_path, '\\');
+
+    if (!dot || (slash && dot < slash) || (backslash && dot < backslash)) {
+        dot = cdl_path + strlen(cdl_path);
+    }
+
+    if ((size_t)(dot - cdl_path) + sizeof(".cdl") <= sizeof(cdl_path)) {
+        strcpy(dot, ".cdl");
+    }
+}
+
+// 已有的文件按位或合并进来, 大小和当前 rom 不一致时不合并
+static void merge_file()
+{
+    FILE *fp = fopen(cdl_path, "rb");
+    if (!fp) {
+        return;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (size != (long)(cdl_prg_size + cdl_chr_size)) {
+        fprintf(stderr, "cdl file %s does not match the rom, ignored!\n", cdl_path);
+        fclose(fp);
+        return;
+    }
+
+    for (size_t i = 0; i < cdl_prg_size + cdl_chr_size; i++) {
+        int value = fgetc(fp);
+        if (value == EOF) {
+            break;
+        }
+
+        if (i < cdl_prg_size) {
+            cdl_prg[i] |= value;
+        } else {
+            cdl_chr[i - cdl_prg_size] |= value;
+        }
+    }
+
+    fclose(fp);
+}
+
+int cdl_start(const char *rom_path)
+{
+    ROM *rom = get_current_rom();
+
+    cdl_stop();
+
+    cdl_prg_size = rom->header->prg_rom_count * PRG_ROM_PAGE_SIZE;
+    cdl_chr_size = rom->header->chr_rom_count * CHR_ROM_PAGE_SIZE;
+    cdl_prg = calloc(cdl_prg_size, 1);
+    cdl_chr = calloc(cdl_chr_size ? cdl_chr_size : 1, 1);
+    if (!cdl_prg || !cdl_chr) {
+        fprintf(stderr, "alloc cdl failed!\n");
+        exit(-1);
+    }
+
+    make_cdl_path(rom_path);
+    merge_file();
+
+    cdl_enabled = 1;
+    bus_invalidate_prg_pages();
+
+    return 0;
+}
+
+// 先合并文件里别的进程写入的记录, 再整个写回去
+int cdl_save()
+{
+    if (!cdl_prg) {
+        return -1;
+    }
+
+    merge_file();
+
+    FILE *fp = fopen(cdl_path, "wb");
+    if (!fp) {
+        fprintf(stderr, "error cannot open file: %s!\n", cdl_path);
+        return -1;
+    }
+
+    fwrite(cdl_prg, 1, cdl_prg_size, fp);
+    fwrite(cdl_chr, 1, cdl_chr_size, fp);
+    fclose(fp);
+
+    return 0;
+}
+
+void cdl_stop()
+{
+    if (!cdl_prg) {
+        return;
+    }
+
+    cdl_enabled = 0;
+    bus_invalidate_prg_pages();
+
+    cdl_save();
+
+    FREE(cdl_prg);
+    FREE(cdl_chr);
+    cdl_prg_size = 0;
+    cdl_chr_size = 0;
+}
+
+// offset 处的一条指令: 第一个字节是操作码, 后面是操作数
+void cdl_log_code_offset(size_t offset, BYTE length)
+{
+    if (offset + length > cdl_prg_size) {
+        return;
+    }
+
+    cdl_prg[offset] |= CDL_PRG_CODE;
+    for (int i = 1; i < length; i++) {
+        cdl_prg[offset + i] |= CDL_PRG_OPERAND;
+    }
+}
+
+// 没有命中预解码缓存的指令, 每个字节可能在不同的 bank 里
+void cdl_log_code(WORD address, BYTE length)
+{
+    for (int i = 0; i < length; i++) {
+        WORD byte_address = address + i;
+        if (byte_address < 0x8000) {
+            continue;
+        }
+
+        size_t offset = prg_rom_offset(byte_address);
+        if (offset < cdl_prg_size) {
+            cdl_prg[offset] |= i ? CDL_PRG_OPERAND : CDL_PRG_CODE;
+        }
+    }
+}
+
+void cdl_log_prg(WORD address, BYTE flags)
+{
+    if (address < 0x8000) {
+        return;
+    }
+
+    size_t offset = prg_rom_offset(address);
+    if (offset >= cdl_prg_size) {
+        return;
+    }
+
+    if (flags == CDL_PRG_DATA && (cdl_prg[offset] & (CDL_PRG_CODE | CDL_PRG_OPERAND))) {
+        return;
+    }
+
+    cdl_prg[offset] |= flags;
+}
+
+void cdl_log_chr(WORD address, BYTE flags)
+{
+    if (!cdl_chr_size || address >= 0x2000) {
+        return;
+    }
+
+    size_t offset = chr_rom_offset(address);
+    if (offset < cdl_chr_size) {
+        cdl_chr[offset] |= flags;
+    }
+}
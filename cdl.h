@@ -0,0 +1,33 @@
+#ifndef __CDL_HEADER__
+#define __CDL_HEADER__
+#include "common.h"
+
+/*
+* 代码/数据记录(Code/Data Logger): PRG-ROM 和 CHR-ROM 的每个字节各有一个字节的标志,
+* 文件是 PRG 的标志后面接着 CHR 的标志, 保存在 rom 旁边的 .cdl 文件里, 每次运行都和已有的文件合并
+*/
+enum {
+    CDL_PRG_CODE = 0x01,          // 作为操作码执行过
+    CDL_PRG_DATA = 0x02,          // 作为数据读过
+    CDL_PRG_OPERAND = 0x04,       // 作为操作数执行过
+    CDL_PRG_INDIRECT_CODE = 0x10, // JMP ($xxxx) 跳到的地方
+    CDL_PRG_INDIRECT_DATA = 0x20, // 通过 (zp,X)、(zp),Y 读过
+};
+
+enum {
+    CDL_CHR_BG = 0x01,            // ppu 画背景时取过
+    CDL_CHR_SPRITE = 0x02,        // ppu 画精灵时取过
+};
+
+extern BYTE cdl_enabled;
+
+int cdl_start(const char *rom_path);
+int cdl_save();
+void cdl_stop();
+
+void cdl_log_code_offset(size_t offset, BYTE length);
+void cdl_log_code(WORD address, BYTE length);
+void cdl_log_prg(WORD address, BYTE flags);
+void cdl_log_chr(WORD address, BYTE flags);
+
+#endif
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <assert.h>
 #include "SDL2/SDL.h"
@@ -161,12 +162,18 @@ typedef struct {
     BYTE X; //变址寄存器
     BYTE Y; //变址寄存器
 
-    //状态寄存器
+    //状态寄存器, N V Z C 不保存在这里, 由下面几个字段延迟计算, 完整的值用 cpu_get_status 读取
     BYTE P;
 
-    BYTE reversed; //保留, 用来作为结构体对齐使用
+    BYTE flag_n; // 最近一次结果, 第 7 位就是 N
+    BYTE flag_v; // 第 7 位就是 V
+    BYTE flag_z; // 最近一次结果, 为 0 时 Z = 1
+    BYTE flag_c; // 0 或者 1
 
-    uint32_t cycle;
+    BYTE extra_cycles; // 这条指令跨页、分支跳转多走的周期, 指令结束时清零
+    BYTE reversed[4]; //保留, 用来作为结构体对齐使用
+
+    uint64_t cycle; // 64 位的主时钟, 长时间运行也不会回绕
     BYTE is_lock;
 
     BYTE ram[CPU_RAM_SIZE];  // 2KB RAM
@@ -214,8 +221,10 @@ typedef struct {
     const char *name;
     BYTE (*prg_rom_read)(WORD);
     void (*prg_rom_write)(WORD, BYTE);
+    size_t (*prg_rom_offset)(WORD);
     BYTE (*chr_rom_read)(WORD);
     void (*chr_rom_write)(WORD, BYTE);
+    size_t (*chr_rom_offset)(WORD);
     void (*irq_scanline)();
     void (*mapper_reset)();
 
@@ -224,17 +233,13 @@ typedef struct {
 void mapper_init();
 BYTE prg_rom_read(WORD address);
 void prg_rom_write(WORD address, BYTE data);
+size_t prg_rom_offset(WORD address);
 BYTE chr_rom_read(WORD address);
+size_t chr_rom_offset(WORD address);
 void chr_rom_write(WORD address, BYTE data);
 void mapper_reset();
 void irq_scanline();
 
-typedef struct
-{
-    uint32_t color;
-    uint8_t value;
-}PIXEL;
-
 
 #define PULSE_COUNT (2)
 #define SAMPLE_BUFFER_SIZE (512)  //缓冲区大小
@@ -272,6 +277,7 @@ void apu_init();
 void update_triangle_timer();
 void update_pulse_timer(uint8_t channel);
 void update_noise_timer();
+void run_apu_timers(uint64_t start_cycle, uint64_t end_cycle);
 void step_apu_frame_counter();
 
 void queue_audio_sample();
@@ -285,16 +291,21 @@ void ppu_init();
 
 #define INLINE_VOID inline void
 
+// 强制内联, 用在取指、寻址和指令操作这些每条指令都要走的小函数上
+#if defined(__GNUC__)
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE static inline
+#endif
+
 void fc_init(const char *filename);
 void fc_release();
 void cpu_reset();
 void ppu_reset();
 
-void cpu_clock();
+void cpu_sync();
 BYTE bus_read(WORD address);
 void bus_write(WORD address, BYTE data);
-BYTE cpu_read(WORD address);
-void cpu_write(WORD address, BYTE data);
 
 //NMI 中断
 void cpu_interrupt_NMI();
@@ -303,7 +314,11 @@ void cpu_init();
 void ppu_init();
 void do_disassemble(WORD addr, BYTE opcode);
 void disassemble();
-BYTE step_cpu();
+uint32_t step_cpu();
+uint32_t cpu_run(uint32_t cycles);
+uint32_t cpu_run_until(uint64_t end_cycle);
+uint32_t cpu_run_frame();
+void cpu_set_profile_period(uint32_t period);
 void set_SDLdevice(SDL_Renderer* renderer, SDL_Texture* texture);
 void step_ppu();
 void set_nmi();
@@ -357,6 +372,105 @@ extern SDL_Window *current_window;
 
 #define PC (cpu.IP)
 
+/*
+* 延迟计算标志位: 指令只记录结果和进位、溢出的输入, cpu.P 里只保留 I、D 和第 4、5 位,
+* 压栈或者需要完整的状态寄存器时再拼出来.
+*/
+static inline BYTE cpu_get_status()
+{
+    return (cpu.P & 0x3C) | (cpu.flag_n & 0x80) | ((cpu.flag_v >> 1) & 0x40) |
+           (cpu.flag_z ? 0 : 0x02) | (cpu.flag_c & 0x01);
+}
+
+static inline void cpu_set_status(BYTE status)
+{
+    cpu.P = status & 0x3C;
+    cpu.flag_n = status;
+    cpu.flag_v = status << 1;
+    cpu.flag_z = ~status & 0x02;
+    cpu.flag_c = status & 0x01;
+}
+
+ALWAYS_INLINE void cpu_clock()
+{
+    cpu.cycle++;
+}
+
+// 跨页和分支跳转多出来的周期不在指令表的周期数里, 指令结束补齐周期时要再加上
+ALWAYS_INLINE void cpu_extra_clock()
+{
+    cpu.cycle++;
+    cpu.extra_cycles++;
+}
+
+// 零页或者栈上有观察点
+extern BYTE bus_watch_low;
+
+/*
+* $0000-$01FF 只可能是内部 RAM, 零页和栈的访问直接读写 cpu.ram, 只计周期, 不经过总线.
+* 零页地址是 BYTE, (zp),Y 和 (zp,X) 取指针时在零页内回绕.
+* 这两页有观察点时才经过总线检查
+*/
+ALWAYS_INLINE BYTE zero_page_read(BYTE address)
+{
+    cpu_clock();
+    if (bus_watch_low) {
+        return bus_read(address);
+    }
+    return cpu.ram[address];
+}
+
+ALWAYS_INLINE void zero_page_write(BYTE address, BYTE data)
+{
+    cpu_clock();
+    if (bus_watch_low) {
+        bus_write(address, data);
+        return;
+    }
+    cpu.ram[address] = data;
+}
+
+ALWAYS_INLINE void stack_push(BYTE data)
+{
+    cpu_clock();
+    if (bus_watch_low) {
+        bus_write(0x100 | cpu.SP, data);
+    } else {
+        cpu.ram[0x100 | cpu.SP] = data;
+    }
+    cpu.SP--;
+}
+
+ALWAYS_INLINE BYTE stack_pop()
+{
+    cpu.SP++;
+    cpu_clock();
+    if (bus_watch_low) {
+        return bus_read(0x100 | cpu.SP);
+    }
+    return cpu.ram[0x100 | cpu.SP];
+}
+
+// 指令的读写, 每次一个周期, 零页和栈不经过总线
+ALWAYS_INLINE BYTE cpu_read(WORD address)
+{
+    cpu_clock();
+    if (address < 0x0200 && !bus_watch_low) {
+        return cpu.ram[address];
+    }
+    return bus_read(address);
+}
+
+ALWAYS_INLINE void cpu_write(WORD address, BYTE data)
+{
+    cpu_clock();
+    if (address < 0x0200 && !bus_watch_low) {
+        cpu.ram[address] = data;
+        return;
+    }
+    bus_write(address, data);
+}
+
 typedef struct
 {
     SDL_Window *window;
@@ -1,58 +1,461 @@
 #include "cpu.h"
 #include "handler.h"
 #include "memory.h"
+#include "ppu.h"
+#include "jit.h"
+#include "profile.h"
+#include "trace.h"
+#include "debugger.h"
+#include "cdl.h"
+
+
+/*
+* 追赶式调度: CPU 每个周期只累加 cpu.cycle, PPU/APU 不再逐周期同步执行,
+* 而是记录已经追赶到的周期, 只在可观察的交互点 (读写 $2000-$401F、mapper 写入、
+* NMI/IRQ 可能产生的时刻、帧结束) 一次性追赶到当前周期.
+*/
+static uint64_t synced_cycle;    // PPU/APU 已经执行到的 cpu 周期
+static uint64_t next_sync_cycle; // 下一个必须同步的 cpu 周期
+
+/*
+* 事件调度: 需要在某个时刻处理的事件各自登记截止周期(64 位的 cpu 周期, 长时间运行也不会回绕),
+* 追赶时按时间顺序逐个处理, 两个事件之间 apu 的计时器成批推进, 不再逐周期取模判断.
+* 截止周期表示追赶到这个周期时事件必须已经处理完. sync 为 1 的事件会被 cpu 观察到,
+* cpu 最晚在其中最早的截止周期停下来同步, 其余的(音频采样) 在追赶时顺带处理.
+*/
+typedef struct {
+    uint64_t cycle;    // 截止周期
+    uint32_t period;   // 周期性事件的间隔, 为 0 时每次同步后重新计算
+    BYTE sync;
+    void (*handler)();
+} EVENT;
+
+enum {
+    EVENT_PPU = 0,       // ppu 的帧结束、vblank/NMI、mapper 的扫描线 IRQ
+    EVENT_FRAME_COUNTER, // apu 帧序列器
+    EVENT_AUDIO_SAMPLE,  // 输出一个音频采样
+    EVENT_PROFILE,       // 采样分析器记录 PC, 关闭时没有处理函数
+    EVENT_COUNT,
+};
+
+// 同一个周期里的事件按下标顺序处理
+static EVENT events[EVENT_COUNT] = {
+    [EVENT_PPU]           = { 0, 0, 1, NULL },
+    [EVENT_FRAME_COUNTER] = { 0, QUARTER_FRAME, 1, step_apu_frame_counter },
+    [EVENT_AUDIO_SAMPLE]  = { 0, PER_SAMPLE, 0, queue_audio_sample },
+    [EVENT_PROFILE]       = { 0, 0, 0, NULL },
+};
+
+// 周期性事件在 cycle % period == 0 的那个周期里处理, 从 cycle 开始重新登记
+static void schedule_periodic_events(uint64_t cycle)
+{
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        uint32_t period = events[i].period;
+        if (period) {
+            events[i].cycle = (cycle + period - 1) / period * period + 1;
+        }
+    }
+}
+
+// 按时间顺序处理 end_cycle 之前到期的事件, apu 追赶到 end_cycle
+static void run_events(uint64_t end_cycle)
+{
+    for (;;) {
+        EVENT *next = NULL;
+        for (int i = 0; i < EVENT_COUNT; i++) {
+            if (events[i].handler && (!next || events[i].cycle < next->cycle)) {
+                next = &events[i];
+            }
+        }
 
-INS code_maps[0X100];
+        if (!next || next->cycle > end_cycle) {
+            break;
+        }
+
+        run_apu_timers(synced_cycle, next->cycle);
+        synced_cycle = next->cycle;
+
+        next->handler();
+        next->cycle += next->period;
+    }
+
+    run_apu_timers(synced_cycle, end_cycle);
+    synced_cycle = end_cycle;
+}
 
-static inline void apu_clock()
+static inline void cpu_sync_reset()
 {
-    // 三角波的更新周期是1 个cpu  周期
-    update_triangle_timer();
+    synced_cycle = cpu.cycle;
+    next_sync_cycle = cpu.cycle;
 
-    // 方波和噪音的更新周期是1 个cpu  周期
-    if (cpu.cycle % 2 == 0) {
-         update_pulse_timer(0);
-         update_pulse_timer(1);
-         update_noise_timer();
+    events[EVENT_PPU].cycle = cpu.cycle;
+    schedule_periodic_events(cpu.cycle);
+}
+
+void cpu_sync()
+{
+    // cpu.cycle 被直接改小时(例如反汇编测试)从当前周期重新计算
+    if (cpu.cycle < synced_cycle) {
+        cpu_sync_reset();
+    } else if (cpu.cycle > synced_cycle) {
+        // PPU 和 APU 之间没有交互, 可以分别成批执行
+        ppu_run((cpu.cycle - synced_cycle) * PPU_DOTS_PER_CPU_CYCLE);
+        run_events(cpu.cycle);
     }
 
-    // 每个四分之一帧执行一次更新包络和长度计时器
-    if (cpu.cycle % QUARTER_FRAME == 0) {
-        step_apu_frame_counter();  // 更新帧计数器
+    // ppu 的事件在第 dots 个点处理完之后才能被 cpu 看到, 多减一个点抵消奇数帧跳过的那个点
+    int dots = ppu_dots_to_next_event();
+    events[EVENT_PPU].cycle = cpu.cycle + (dots > 0 ? (dots - 1) / PPU_DOTS_PER_CPU_CYCLE : 0) + 1;
+
+    next_sync_cycle = UINT64_MAX;
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        if (events[i].sync && events[i].cycle < next_sync_cycle) {
+            next_sync_cycle = events[i].cycle;
+        }
     }
+}
 
-    // 40 个周期, 推送音频样本到缓冲区
-    if (cpu.cycle % PER_SAMPLE == 0) {
-        queue_audio_sample();
+/*
+* 打开或者关闭采样事件, period 为 0 时关闭.
+* 采样要看到 cpu 当前的 PC, 所以是同步事件: cpu 在指令边界停下来同步时记录
+*/
+void cpu_set_profile_period(uint32_t period)
+{
+    EVENT *event = &events[EVENT_PROFILE];
+
+    event->period = period;
+    event->sync = period != 0;
+    event->handler = period ? profiler_sample : NULL;
+
+    if (period) {
+        event->cycle = cpu.cycle + period;
+        if (event->cycle < next_sync_cycle) {
+            next_sync_cycle = event->cycle;
+        }
     }
 }
 
-void cpu_clock()
+/*
+* 预解码缓存: PRG-ROM 的每个字节 (按 bank 内的物理偏移) 对应一个预解码项,
+* 记录操作码、执行函数、周期数和紧跟其后的两个操作数字节.
+* ROM 内容不会改变, 表项一旦解码就一直有效; mapper 切换 bank 时只需要重新计算
+* $8000-$FFFF 四个 8KB 窗口指向哪一段表项.
+* RAM 里执行的代码可能被改写, 不走缓存, 仍然按原来的方式取指.
+*/
+#define DECODE_WINDOW_SIZE (0x2000)
+
+enum {
+    DECODE_EMPTY = 0,
+    DECODE_READY,
+    DECODE_UNCACHED, // 指令跨越了 8KB 窗口, 操作数可能在另一个 bank 里
+};
+
+static DECODED_INS *decode_cache = NULL;
+static size_t decode_cache_size = 0;
+static DECODED_INS *prg_window[4];
+static BYTE prg_window_ready = 0;
+
+// 当前正在执行的指令的预解码项, 为 NULL 时从总线读取操作数
+static const DECODED_INS *current_entry = NULL;
+
+static void decode_cache_reset()
 {
-    int i;
-    for (i = 0; i < 3; i++) {
-        step_ppu();
+    FREE(decode_cache);
+
+    decode_cache_size = get_current_rom()->header->prg_rom_count * PRG_ROM_PAGE_SIZE;
+    decode_cache = calloc(decode_cache_size, sizeof(DECODED_INS));
+    if (!decode_cache) {
+        fprintf(stderr, "alloc decode cache failed!\n");
+        exit(-1);
     }
 
-    apu_clock();
+    prg_window_ready = 0;
+    current_entry = NULL;
 
-    cpu.cycle++;
+#ifdef CPU_JIT
+    jit_reset();
+#endif
 }
 
-BYTE cpu_read(WORD address)
+void cpu_invalidate_decode_cache()
 {
-    cpu_clock();
-    return bus_read(address);
+    prg_window_ready = 0;
 }
 
-void cpu_write(WORD address, BYTE data)
+static void update_prg_window()
 {
-    cpu_clock();
-    return bus_write(address, data);
+    for (int i = 0; i < 4; i++) {
+        size_t offset = prg_rom_offset(0x8000 + i * DECODE_WINDOW_SIZE);
+
+        // mapper 指向了 ROM 之外的 bank, 这个窗口不缓存
+        prg_window[i] = NULL;
+        if (decode_cache && offset + DECODE_WINDOW_SIZE <= decode_cache_size) {
+            prg_window[i] = decode_cache + offset;
+        }
+    }
+
+    prg_window_ready = 1;
+}
+
+/*
+* 融合指令: 游戏代码里常见的指令对, 前一条执行完后直接执行下一条,
+* 省掉中间的取指和分派. 两条指令之间仍然检查同步点和中断, 时序和分开执行完全一样.
+* 用 make CPU_FUSION=stats 统计操作码对的频率和每种融合的命中次数, 据此增删表项.
+* FUSION(前一条, 执行函数, 后一条, 执行函数)
+*/
+#define FUSION_TABLE(f) \
+    f(CA, DEX_CA, D0, BNE_D0) \
+    f(88, DEY_88, D0, BNE_D0) \
+    f(CA, DEX_CA, 10, BPL_10) \
+    f(88, DEY_88, 10, BPL_10) \
+    f(E8, INX_E8, D0, BNE_D0) \
+    f(C8, INY_C8, D0, BNE_D0) \
+    f(C9, CMP_C9, F0, BEQ_F0) \
+    f(C9, CMP_C9, D0, BNE_D0) \
+    f(C5, CMP_C5, F0, BEQ_F0) \
+    f(C5, CMP_C5, D0, BNE_D0) \
+    f(A9, LDA_A9, 85, STA_85) \
+    f(A9, LDA_A9, 8D, STA_8D) \
+    f(A5, LDA_A5, 85, STA_85) \
+    f(A5, LDA_A5, 8D, STA_8D) \
+    f(AD, LDA_AD, 85, STA_85) \
+    f(AD, LDA_AD, 8D, STA_8D) \
+    f(E6, INC_E6, A5, LDA_A5)
+
+#define FUSION_ENUM(a, fa, b, fb) FUSION_##a##_##b,
+
+enum {
+    FUSION_NONE = 0,
+    FUSION_TABLE(FUSION_ENUM)
+    FUSION_COUNT,
+};
+
+#undef FUSION_ENUM
+
+static inline BYTE find_fusion(BYTE first, BYTE second)
+{
+#define FUSION_CASE(a, fa, b, fb) case 0x##a##b: return FUSION_##a##_##b;
+
+    switch ((first << 8) | second) {
+        FUSION_TABLE(FUSION_CASE)
+    }
+
+#undef FUSION_CASE
+
+    return FUSION_NONE;
+}
+
+#ifdef CPU_FUSION_STATS
+
+static uint32_t opcode_pair_counts[0x10000];
+static uint32_t fusion_counts[FUSION_COUNT];
+static BYTE last_opcode;
+
+static inline void count_opcode_pair(BYTE opcode)
+{
+    opcode_pair_counts[(last_opcode << 8) | opcode]++;
+    last_opcode = opcode;
+}
+
+static void print_fusion_stats()
+{
+    fprintf(stderr, "opcode pairs:\n");
+
+    // 每次挑出剩下的最大值, 只打印前 32 个
+    static BYTE printed[0x10000];
+    for (int n = 0; n < 32; n++) {
+        int best = -1;
+        for (int i = 0; i < 0x10000; i++) {
+            if (!printed[i] && opcode_pair_counts[i] && (best < 0 || opcode_pair_counts[i] > opcode_pair_counts[best])) {
+                best = i;
+            }
+        }
+
+        if (best < 0) {
+            break;
+        }
+
+        printed[best] = 1;
+        fprintf(stderr, "  %02X %02X  %-4s%-4s %10u%s\n", best >> 8, best & 0xFF,
+            code_maps[best >> 8].op_name, code_maps[best & 0xFF].op_name, opcode_pair_counts[best],
+            find_fusion(best >> 8, best & 0xFF) ? "  (fused)" : "");
+    }
+
+#define FUSION_PRINT(a, fa, b, fb) \
+    fprintf(stderr, "  " #fa " + " #fb "  %10u\n", fusion_counts[FUSION_##a##_##b]);
+
+    fprintf(stderr, "fusions:\n");
+    FUSION_TABLE(FUSION_PRINT)
+
+#undef FUSION_PRINT
+}
+
+#else
+
+static inline void count_opcode_pair(BYTE opcode)
+{
+    (void)opcode;
+}
+
+#endif
+
+static inline void decode_entry(DECODED_INS *entry, WORD address)
+{
+    if ((address & (DECODE_WINDOW_SIZE - 1)) > DECODE_WINDOW_SIZE - 3) {
+        entry->state = DECODE_UNCACHED;
+        return;
+    }
+
+    BYTE opcode = prg_rom_read(address);
+
+    entry->opcode = opcode;
+    entry->op_func = code_maps[opcode].op_func;
+    entry->cycle = code_maps[opcode].cycle;
+    entry->operand = prg_rom_read(address + 1) | (prg_rom_read(address + 2) << 8);
+    entry->state = DECODE_READY;
+    entry->fusion = FUSION_NONE;
+
+    // 下一条指令也要在同一个窗口里, 并且能被缓存
+    WORD next = address + code_maps[opcode].op_len;
+    if ((next & (DECODE_WINDOW_SIZE - 1)) > DECODE_WINDOW_SIZE - 3 || (next >> 13) != (address >> 13)) {
+        return;
+    }
+
+    BYTE fusion = find_fusion(opcode, prg_rom_read(next));
+    if (fusion == FUSION_NONE) {
+        return;
+    }
+
+    DECODED_INS *next_entry = entry + code_maps[opcode].op_len;
+    if (next_entry->state == DECODE_EMPTY) {
+        decode_entry(next_entry, next);
+    }
+
+    entry->fusion = fusion;
+}
+
+/*
+* 成批执行: 一段直线代码只访问内部 RAM 和 PRG-ROM, 周期数在解码时就确定,
+* 只要整段在下一个同步点之前结束, 中间不可能有 ppu/apu 事件和中断,
+* 就可以不做每条指令之间的检查, 最后一次性算上整段的周期数.
+* make CPU_BATCH=verify 时每一段都会再逐条执行一遍并对比结果.
+*/
+#define BATCH_MAX_INSTRUCTIONS (16)
+
+static inline int is_batchable(const DECODED_INS *entry)
+{
+    const INS *ins = &code_maps[entry->opcode];
+
+    switch (ins->mode) {
+        case ADDR_IMP:
+        case ADDR_ACC:
+            // BRK/RTI/RTS 会跳转, KIL 的周期数是 0
+            return entry->opcode != 0x00 && entry->opcode != 0x40 && entry->opcode != 0x60 && ins->cycle;
+        case ADDR_IMM:
+        case ADDR_ZP:
+        case ADDR_ZPX:
+        case ADDR_ZPY:
+            return 1;
+        case ADDR_ABS:
+            // 只有内部 RAM, 不包括 JMP/JSR
+            return entry->operand < 0x2000 && entry->opcode != 0x4C && entry->opcode != 0x20;
+        default:
+            return 0;
+    }
+}
+
+// 计算从 entry 开始可以成批执行的指令数和总周期数, 至少是 1 条
+static void decode_batch(DECODED_INS *entry, WORD address)
+{
+    DECODED_INS *next = entry;
+    BYTE count = 0, cycles = 0;
+
+    while (count < BATCH_MAX_INSTRUCTIONS && next->state == DECODE_READY && is_batchable(next)) {
+        count++;
+        cycles += next->cycle;
+
+        // 下一条要在同一个窗口里
+        WORD next_address = address + code_maps[next->opcode].op_len;
+        if ((next_address >> 13) != (address >> 13)) {
+            break;
+        }
+
+        next += code_maps[next->opcode].op_len;
+        address = next_address;
+        if (next->state == DECODE_EMPTY) {
+            decode_entry(next, address);
+        }
+    }
+
+    entry->batch = count > 1 ? count : 1;
+    entry->batch_cycles = cycles;
+}
+
+static inline DECODED_INS *decode_lookup(WORD address)
+{
+    if (address < 0x8000) {
+        return NULL;
+    }
+
+    if (!prg_window_ready) {
+        update_prg_window();
+    }
+
+    DECODED_INS *window = prg_window[(address >> 13) & 0x3];
+    if (!window) {
+        return NULL;
+    }
+
+    DECODED_INS *entry = window + (address & (DECODE_WINDOW_SIZE - 1));
+    if (!entry->batch) {
+        if (entry->state == DECODE_EMPTY) {
+            decode_entry(entry, address);
+        }
+
+        decode_batch(entry, address);
+    }
+
+    return entry->state == DECODE_READY ? entry : NULL;
+}
+
+// 代码/数据记录: 预解码项在表里的位置就是它在 PRG-ROM 里的偏移
+static inline void cdl_log_entry(const DECODED_INS *entry)
+{
+    cdl_log_code_offset(entry - decode_cache, code_maps[entry->opcode].op_len);
+}
+
+// 取操作码, 同时定位当前指令的预解码项
+static inline BYTE fetch_opcode()
+{
+    current_entry = decode_lookup(PC);
+    if (current_entry) {
+        if (cdl_enabled) {
+            cdl_log_entry(current_entry);
+        }
+        return current_entry->opcode;
+    }
+
+    // 先记为代码, 接下来经过总线的读取就不会记为数据
+    if (cdl_enabled && PC >= 0x8000) {
+        cdl_log_code(PC, code_maps[prg_rom_read(PC)].op_len);
+    }
+
+    return bus_read(PC);
+}
+
+// 取指令的第 n 个操作数字节, 命中缓存时不再访问总线, 但周期照算
+ALWAYS_INLINE BYTE fetch_operand(BYTE n)
+{
+    if (current_entry) {
+        cpu_clock();
+        return current_entry->operand >> ((n - 1) * 8);
+    }
+
+    return cpu_read(PC + n);
 }
 
 //立即寻址
-static inline WORD immediate_addressing()
+ALWAYS_INLINE WORD immediate_addressing()
 {
     WORD addr = PC + 1;
     PC += 1;
@@ -61,10 +464,10 @@ static inline WORD immediate_addressing()
 }
 
 //绝对寻址
-static inline WORD absolute_addressing()
+ALWAYS_INLINE WORD absolute_addressing()
 {
-    BYTE addr1 = cpu_read(PC + 1);
-    BYTE addr2 = cpu_read(PC + 2);
+    BYTE addr1 = fetch_operand(1);
+    BYTE addr2 = fetch_operand(2);
     WORD addr = (addr2 << 8 | addr1);
     PC += 3;
 
@@ -72,49 +475,48 @@ static inline WORD absolute_addressing()
 }
 
 //绝对零页寻址
-static inline WORD zero_absolute_addressing()
+ALWAYS_INLINE WORD zero_absolute_addressing()
 {
-    BYTE addr = cpu_read(PC + 1);
+    BYTE addr = fetch_operand(1);
     PC += 2;
 
     return (addr & 0xFF);
 }
 
 //绝对 X 变址
-static inline WORD absolute_X_indexed_addressing(BYTE op)
+ALWAYS_INLINE WORD absolute_X_indexed_addressing(BYTE op)
 {
-    BYTE addr1 = cpu_read(PC + 1);
-    BYTE addr2 = cpu_read(PC + 2);
+    BYTE addr1 = fetch_operand(1);
+    BYTE addr2 = fetch_operand(2);
     PC += 3;
 
     WORD addr = (addr2 << 8) | addr1;
 
-    if( code_maps[op].cycle < 5 && (addr >> 8) != ((addr + cpu.X) >> 8) )
-        cpu_clock();
+    if( code_maps[op].page_cross && (addr >> 8) != ((addr + cpu.X) >> 8) )
+        cpu_extra_clock();
 
     return (addr + cpu.X);
 }
 
 //绝对 Y 变址
-static inline WORD absolute_Y_indexed_addressing(BYTE is_store_instr)
+ALWAYS_INLINE WORD absolute_Y_indexed_addressing(BYTE op)
 {
-    BYTE addr1 = cpu_read(PC + 1);
-    BYTE addr2 = cpu_read(PC + 2);
+    BYTE addr1 = fetch_operand(1);
+    BYTE addr2 = fetch_operand(2);
     PC += 3;
 
     WORD addr = (addr2 << 8) | addr1;
 
-    if (!is_store_instr) {
-        if((addr >> 8) != ((addr + cpu.Y) >> 8))cpu_clock();
-    }
+    if (code_maps[op].page_cross && (addr >> 8) != ((addr + cpu.Y) >> 8))
+        cpu_extra_clock();
 
     return (addr + cpu.Y);
 }
 
 //零页 X 间接寻址
-static inline WORD zero_X_indexed_addressing()
+ALWAYS_INLINE WORD zero_X_indexed_addressing()
 {
-    BYTE addr = cpu_read(PC + 1);
+    BYTE addr = fetch_operand(1);
     addr += cpu.X;
     PC += 2;
 
@@ -122,19 +524,19 @@ static inline WORD zero_X_indexed_addressing()
 }
 
 //零页 Y 间接 寻址
-static inline WORD zero_Y_indexed_addressing()
+ALWAYS_INLINE WORD zero_Y_indexed_addressing()
 {
-    BYTE addr = cpu_read(PC + 1);
+    BYTE addr = fetch_operand(1);
     addr += cpu.Y;
     PC += 2;
 
     return (addr & 0xFF);
 }
 
-static inline WORD indirect_addressing()
+ALWAYS_INLINE WORD indirect_addressing()
 {
-    BYTE addr1 = cpu_read(PC + 1);
-    BYTE addr2 = cpu_read(PC + 2);
+    BYTE addr1 = fetch_operand(1);
+    BYTE addr2 = fetch_operand(2);
     PC += 3;
 
     WORD addr = (addr2 << 8) | addr1;
@@ -152,55 +554,224 @@ static inline WORD indirect_addressing()
 }
 
 // x 变址间接 寻址
-static inline WORD indexed_X_indirect_addressing()
+ALWAYS_INLINE WORD indexed_X_indirect_addressing()
 {
-    BYTE addr1 = cpu_read(PC + 1);
+    BYTE addr1 = fetch_operand(1);
     addr1 += cpu.X;
 
     BYTE addr2 = addr1 + 1;
-    WORD addr = (cpu_read(addr2) << 8) | cpu_read(addr1);
+    WORD addr = (zero_page_read(addr2) << 8) | zero_page_read(addr1);
 
     PC += 2;
 
+    if (cdl_enabled) {
+        cdl_log_prg(addr, CDL_PRG_INDIRECT_DATA);
+    }
+
     return addr;
 }
 
 //Y 间接 变址寻址
-static inline WORD indirect_Y_indexed_addressing(BYTE is_store_instr)
+ALWAYS_INLINE WORD indirect_Y_indexed_addressing(BYTE op)
 {
-    BYTE addr1 = cpu_read(PC + 1);
+    BYTE addr1 = fetch_operand(1);
     BYTE addr2 = (addr1 + 1) & 0xFF;  // 确保在页面边界正确处理
-    WORD addr = (cpu_read(addr2) << 8) | cpu_read(addr1);
+    WORD addr = (zero_page_read(addr2) << 8) | zero_page_read(addr1);
     PC += 2;
 
-    if (!is_store_instr) {
-        WORD addr_plus_Y = addr + cpu.Y;
-        if ((addr & 0xFF00) != (addr_plus_Y & 0xFF00)) {
-           cpu_clock();
-        }
+    WORD addr_plus_Y = addr + cpu.Y;
+    if (code_maps[op].page_cross && (addr & 0xFF00) != (addr_plus_Y & 0xFF00)) {
+       cpu_extra_clock();
     }
 
-    return addr + cpu.Y;
+    if (cdl_enabled) {
+        cdl_log_prg(addr_plus_Y, CDL_PRG_INDIRECT_DATA);
+    }
+
+    return addr_plus_Y;
 }
 
-static inline WORD relative_addressing()
+ALWAYS_INLINE WORD relative_addressing()
 {
     //先算下一条指令的地址, 再算偏移
-    int8_t of = (int8_t)cpu_read(PC + 1);
+    int8_t of = (int8_t)fetch_operand(1);
     PC += 2;
 
+    // 先补上第二个周期, 和 JMP_4C 一样, 空转检测要用指令结束时的周期
+    cpu_clock();
+
     WORD addr = PC + of;
 
     return addr;
 }
 
+/*
+* 空转循环: 等待 NMI 的游戏经常反复执行 "LDA $xx / BEQ" 或者 "BIT $2002 / BPL" 这样的短循环.
+* 循环体是一段只读 RAM/ROM 或 $2002、不写内存的直线代码, 连续两次跳回开头时寄存器完全相同,
+* 那么在下一个同步点(也就是可能产生中断的时刻)之前, 它只会原样重复, 可以直接把整圈的周期加上去.
+* 读 $2002 的循环还要求 vblank 标志已经被读掉, 并且 ppu 在这段时间里不会改变 $2002.
+*/
+#define IDLE_LOOP_MAX_BYTES (16)
+
+enum {
+    IDLE_LOOP_NONE = 0,
+    IDLE_LOOP_MEMORY, // 只读内存
+    IDLE_LOOP_STATUS, // 还会读 $2002
+};
+
+static struct {
+    const DECODED_INS *branch; // 循环末尾跳转指令的预解码项, 按物理地址区分不同 bank 里的代码
+    WORD target;
+    BYTE kind;
+
+    BYTE valid;                // 上一次跳回开头时的快照是否可用
+    BYTE A, X, Y, P, SP;
+    uint64_t cycle;
+    uint64_t stable_cycle;     // 这个周期之前 ppu 不会改变 $2002
+} idle_loop;
+
+static uint64_t run_end_cycle; // 这一次 cpu_run 要停下来的周期
+static uint64_t block_end_cycle; // 融合指令和成批执行的指令都要在这之前开始, 单步执行时为 0
+
+static inline void idle_loop_reset()
+{
+    memset(&idle_loop, 0, sizeof(idle_loop));
+}
+
+// 循环体里的一条指令能否反复执行而没有副作用, 可以时返回指令长度, 否则返回 0
+static inline BYTE idle_instruction_length(const DECODED_INS *entry, BYTE *kind)
+{
+    WORD address = entry->operand;
+
+    switch (entry->opcode) {
+        // 寄存器之间的传送、加减和标志位
+        case 0xAA: case 0xA8: case 0x8A: case 0x98: case 0xE8: case 0xC8:
+        case 0xCA: case 0x88: case 0x18: case 0x38: case 0xB8: case 0xEA:
+            return 1;
+
+        // 立即数和零页的 LDA LDX LDY CMP CPX CPY AND ORA EOR (BIT)
+        case 0xA9: case 0xA2: case 0xA0: case 0xC9: case 0xE0: case 0xC0:
+        case 0x29: case 0x09: case 0x49:
+        case 0xA5: case 0xA6: case 0xA4: case 0xC5: case 0xE4: case 0xC4:
+        case 0x25: case 0x05: case 0x45: case 0x24:
+            return 2;
+
+        // 绝对地址, 只允许没有副作用的 RAM、SRAM、PRG-ROM 和 $2002
+        case 0xAD: case 0xAE: case 0xAC: case 0xCD: case 0xEC: case 0xCC:
+        case 0x2D: case 0x0D: case 0x4D: case 0x2C:
+            if (address < 0x2000 || address >= 0x6000) {
+                return 3;
+            }
+
+            if ((address & 0xE007) == 0x2002) {
+                *kind = IDLE_LOOP_STATUS;
+                return 3;
+            }
+
+            return 0;
+    }
+
+    return 0;
+}
+
+// 检查 target 到 branch (循环末尾的跳转) 之间是不是空转循环
+static BYTE analyze_idle_loop(WORD target, WORD branch)
+{
+    BYTE kind = IDLE_LOOP_MEMORY;
+    WORD address = target;
+
+    if (target > branch || branch - target > IDLE_LOOP_MAX_BYTES) {
+        return IDLE_LOOP_NONE;
+    }
+
+    while (address != branch) {
+        const DECODED_INS *entry = decode_lookup(address);
+        BYTE length = entry ? idle_instruction_length(entry, &kind) : 0;
+
+        if (!length || branch - address < length) {
+            return IDLE_LOOP_NONE;
+        }
+
+        address += length;
+    }
+
+    return kind;
+}
+
+static void skip_idle_loop(WORD branch)
+{
+    const DECODED_INS *entry = decode_lookup(branch);
+    if (!entry) {
+        idle_loop.valid = 0;
+        return;
+    }
+
+    if (entry != idle_loop.branch || PC != idle_loop.target) {
+        idle_loop.branch = entry;
+        idle_loop.target = PC;
+        idle_loop.kind = analyze_idle_loop(PC, branch);
+        idle_loop.valid = 0;
+    }
+
+    if (idle_loop.kind == IDLE_LOOP_NONE) {
+        return;
+    }
+
+    if (idle_loop.valid && !cpu.interrupt && idle_loop.A == cpu.A && idle_loop.X == cpu.X &&
+        idle_loop.Y == cpu.Y && idle_loop.P == cpu_get_status() && idle_loop.SP == cpu.SP) {
+
+        // 跳过的每一圈都要在同步点、cpu_run 的终点之前结束
+        uint64_t loop_cycles = cpu.cycle - idle_loop.cycle;
+        uint64_t limit_cycle = next_sync_cycle;
+
+        if (run_end_cycle < limit_cycle) {
+            limit_cycle = run_end_cycle;
+        }
+
+        if (idle_loop.kind == IDLE_LOOP_STATUS && idle_loop.stable_cycle < limit_cycle) {
+            limit_cycle = idle_loop.stable_cycle;
+        }
+
+        if (limit_cycle > cpu.cycle) {
+            cpu.cycle += (limit_cycle - cpu.cycle) / loop_cycles * loop_cycles;
+        }
+    }
+
+    idle_loop.valid = 1;
+    idle_loop.A = cpu.A;
+    idle_loop.X = cpu.X;
+    idle_loop.Y = cpu.Y;
+    idle_loop.P = cpu_get_status();
+    idle_loop.SP = cpu.SP;
+    idle_loop.cycle = cpu.cycle;
+
+    if (idle_loop.kind == IDLE_LOOP_STATUS) {
+        cpu_sync();
+
+        int dots = ppu_dots_to_status_change();
+        idle_loop.valid = !(ppu.ppustatus & 0x80);
+        idle_loop.stable_cycle = cpu.cycle + (dots > 0 ? (dots - 1) / PPU_DOTS_PER_CPU_CYCLE + 1 : 0);
+    }
+}
+
+// 跳转指令执行完之后调用, branch 是跳转指令自己的地址; 向前跳或者没有跳, 说明离开了循环
+ALWAYS_INLINE void check_idle_loop(WORD branch)
+{
+    if (PC > branch || branch - PC > IDLE_LOOP_MAX_BYTES) {
+        idle_loop.valid = 0;
+        return;
+    }
+
+    skip_idle_loop(branch);
+}
+
 //BRK 中断
-void BRK_00(BYTE op)
+ALWAYS_INLINE void BRK_00(BYTE op)
 {
     //这里的addr 没啥用
     WORD addr = 0;
 
-    uint32_t last_cycle = cpu.cycle;
+    uint64_t last_cycle = cpu.cycle;
 
     handler_BRK(addr);
 
@@ -210,63 +781,63 @@ void BRK_00(BYTE op)
     }
 }
 
-void ORA_01(BYTE op)
+ALWAYS_INLINE void ORA_01(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_ORA(addr);
 }
 
-void KIL_02(BYTE op)
+ALWAYS_INLINE void KIL_02(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void SLO_03(BYTE op)
+ALWAYS_INLINE void SLO_03(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_SLO(addr);
 }
 
-void DOP_04(BYTE op)
+ALWAYS_INLINE void DOP_04(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_DOP(addr);
 }
 
-void ORA_05(BYTE op)
+ALWAYS_INLINE void ORA_05(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_ORA(addr);
 }
 
-void ASL_06(BYTE op)
+ALWAYS_INLINE void ASL_06(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_ASL(addr);
 }
 
-void SLO_07(BYTE op)
+ALWAYS_INLINE void SLO_07(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_SLO(addr);
 }
 
-void PHP_08(BYTE op)
+ALWAYS_INLINE void PHP_08(BYTE op)
 {
     WORD addr = 0;
 
     handler_PHP(addr);
 }
 
-void ORA_09(BYTE op)
+ALWAYS_INLINE void ORA_09(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -274,14 +845,14 @@ void ORA_09(BYTE op)
     handler_ORA(addr);
 }
 
-void ASL_0A(BYTE op)
+ALWAYS_INLINE void ASL_0A(BYTE op)
 {
     WORD addr = 0;
 
     handler_ASL_REG(addr);
 }
 
-void AAC_0B(BYTE op)
+ALWAYS_INLINE void AAC_0B(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -289,210 +860,212 @@ void AAC_0B(BYTE op)
     handler_AAC(addr);
 }
 
-void NOP_0C(BYTE op)
+ALWAYS_INLINE void NOP_0C(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_NOP(addr);
 }
 
-void ORA_0D(BYTE op)
+ALWAYS_INLINE void ORA_0D(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_ORA(addr);
 }
 
-void ASL_0E(BYTE op)
+ALWAYS_INLINE void ASL_0E(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_ASL(addr);
 }
 
-void SLO_0F(BYTE op)
+ALWAYS_INLINE void SLO_0F(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_SLO(addr);
 }
 
-void BPL_10(BYTE op)
+ALWAYS_INLINE void BPL_10(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BPL(addr);
+    check_idle_loop(branch);
 }
 
-void ORA_11(BYTE op)
+ALWAYS_INLINE void ORA_11(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_ORA(addr);
 }
 
-void KIL_12(BYTE op)
+ALWAYS_INLINE void KIL_12(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void SLO_13(BYTE op)
+ALWAYS_INLINE void SLO_13(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_SLO(addr);
 }
 
-void DOP_14(BYTE op)
+ALWAYS_INLINE void DOP_14(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     (void)addr;
 }
 
-void ORA_15(BYTE op)
+ALWAYS_INLINE void ORA_15(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_ORA(addr);
 }
 
-void ASL_16(BYTE op)
+ALWAYS_INLINE void ASL_16(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_ASL(addr);
 }
 
-void SLO_17(BYTE op)
+ALWAYS_INLINE void SLO_17(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_SLO(addr);
 }
 
-void CLC_18(BYTE op)
+ALWAYS_INLINE void CLC_18(BYTE op)
 {
     WORD addr = 0;
 
     handler_CLC(addr);
 }
 
-void ORA_19(BYTE op)
+ALWAYS_INLINE void ORA_19(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_ORA(addr);
 }
 
-void NOP_1A(BYTE op)
+ALWAYS_INLINE void NOP_1A(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_NOP(addr);
 }
 
-void SLO_1B(BYTE op)
+ALWAYS_INLINE void SLO_1B(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_SLO(addr);
 }
 
-void TOP_1C(BYTE op)
+ALWAYS_INLINE void TOP_1C(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_TOP(addr);
 }
 
-void ORA_1D(BYTE op)
+ALWAYS_INLINE void ORA_1D(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_ORA(addr);
 }
 
-void ASL_1E(BYTE op)
+ALWAYS_INLINE void ASL_1E(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_ASL(addr);
 }
 
-void SLO_1F(BYTE op)
+ALWAYS_INLINE void SLO_1F(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_SLO(addr);
 }
 
-void JSR_20(BYTE op)
+ALWAYS_INLINE void JSR_20(BYTE op)
 {
     WORD addr = 0;
 
     handler_JSR(addr);
 }
 
-void AND_21(BYTE op)
+ALWAYS_INLINE void AND_21(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_AND(addr);
 }
 
-void KIL_22(BYTE op)
+ALWAYS_INLINE void KIL_22(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void RLA_23(BYTE op)
+ALWAYS_INLINE void RLA_23(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_RLA(addr);
 }
 
-void BIT_24(BYTE op)
+ALWAYS_INLINE void BIT_24(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_BIT(addr);
 }
 
-void AND_25(BYTE op)
+ALWAYS_INLINE void AND_25(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_AND(addr);
 }
 
-void ROL_26(BYTE op)
+ALWAYS_INLINE void ROL_26(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_ROL(addr);
 }
 
-void RLA_27(BYTE op)
+ALWAYS_INLINE void RLA_27(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_RLA(addr);
 }
 
-void PLP_28(BYTE op)
+ALWAYS_INLINE void PLP_28(BYTE op)
 {
     WORD addr = 0;
 
     handler_PLP(addr);
 }
 
-void AND_29(BYTE op)
+ALWAYS_INLINE void AND_29(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -500,14 +1073,14 @@ void AND_29(BYTE op)
     handler_AND(addr);
 }
 
-void ROL_2A(BYTE op)
+ALWAYS_INLINE void ROL_2A(BYTE op)
 {
     WORD addr = 0;
 
     handler_ROL_REG_A(addr);
 }
 
-void AAC_2B(BYTE op)
+ALWAYS_INLINE void AAC_2B(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -515,210 +1088,212 @@ void AAC_2B(BYTE op)
     handler_AAC(addr);
 }
 
-void BIT_2C(BYTE op)
+ALWAYS_INLINE void BIT_2C(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_BIT(addr);
 }
 
-void AND_2D(BYTE op)
+ALWAYS_INLINE void AND_2D(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_AND(addr);
 }
 
-void ROL_2E(BYTE op)
+ALWAYS_INLINE void ROL_2E(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_ROL(addr);
 }
 
-void RLA_2F(BYTE op)
+ALWAYS_INLINE void RLA_2F(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_RLA(addr);
 }
 
-void BMI_30(BYTE op)
+ALWAYS_INLINE void BMI_30(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BMI(addr);
+    check_idle_loop(branch);
 }
 
-void AND_31(BYTE op)
+ALWAYS_INLINE void AND_31(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_AND(addr);
 }
 
-void KIL_32(BYTE op)
+ALWAYS_INLINE void KIL_32(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void RLA_33(BYTE op)
+ALWAYS_INLINE void RLA_33(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_RLA(addr);
 }
 
-void DOP_34(BYTE op)
+ALWAYS_INLINE void DOP_34(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_DOP(addr);
 }
 
-void AND_35(BYTE op)
+ALWAYS_INLINE void AND_35(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_AND(addr);
 }
 
-void ROL_36(BYTE op)
+ALWAYS_INLINE void ROL_36(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_ROL(addr);
 }
 
-void RLA_37(BYTE op)
+ALWAYS_INLINE void RLA_37(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_RLA(addr);
 }
 
-void SEC_38(BYTE op)
+ALWAYS_INLINE void SEC_38(BYTE op)
 {
     WORD addr = 0;
 
     handler_SEC(addr);
 }
 
-void AND_39(BYTE op)
+ALWAYS_INLINE void AND_39(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_AND(addr);
 }
 
-void NOP_3A(BYTE op)
+ALWAYS_INLINE void NOP_3A(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_NOP(addr);
 }
 
-void RLA_3B(BYTE op)
+ALWAYS_INLINE void RLA_3B(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_RLA(addr);
 }
 
-void TOP_3C(BYTE op)
+ALWAYS_INLINE void TOP_3C(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_TOP(addr);
 }
 
-void AND_3D(BYTE op)
+ALWAYS_INLINE void AND_3D(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_AND(addr);
 }
 
-void ROL_3E(BYTE op)
+ALWAYS_INLINE void ROL_3E(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_ROL(addr);
 }
 
-void RLA_3F(BYTE op)
+ALWAYS_INLINE void RLA_3F(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_RLA(addr);
 }
 
-void RTI_40(BYTE op)
+ALWAYS_INLINE void RTI_40(BYTE op)
 {
     WORD addr = 0;
 
     handler_RTI(addr);
 }
 
-void EOR_41(BYTE op)
+ALWAYS_INLINE void EOR_41(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_EOR(addr);
 }
 
-void KIL_42(BYTE op)
+ALWAYS_INLINE void KIL_42(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void SRE_43(BYTE op)
+ALWAYS_INLINE void SRE_43(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_SRE(addr);
 }
 
-void DOP_44(BYTE op)
+ALWAYS_INLINE void DOP_44(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_DOP(addr);
 }
 
-void EOR_45(BYTE op)
+ALWAYS_INLINE void EOR_45(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_EOR(addr);
 }
 
-void LSR_46(BYTE op)
+ALWAYS_INLINE void LSR_46(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_LSR(addr);
 }
 
-void SRE_47(BYTE op)
+ALWAYS_INLINE void SRE_47(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_SRE(addr);
 }
 
-void PHA_48(BYTE op)
+ALWAYS_INLINE void PHA_48(BYTE op)
 {
     WORD addr = 0;
 
     handler_PHA(addr);
 }
 
-void EOR_49(BYTE op)
+ALWAYS_INLINE void EOR_49(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -726,224 +1301,230 @@ void EOR_49(BYTE op)
     handler_EOR(addr);
 }
 
-void LSR_4A(BYTE op)
+ALWAYS_INLINE void LSR_4A(BYTE op)
 {
     WORD addr = 0;
 
     handler_LSR_REG_A(addr);
 }
 
-void ASR_4B(BYTE op)
+ALWAYS_INLINE void ASR_4B(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_ASR(addr);
 }
 
-void JMP_4C(BYTE op)
+ALWAYS_INLINE void JMP_4C(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = absolute_addressing();
 
+    // 先补上最后一个周期, 空转检测要用指令结束时的周期
+    cpu_clock();
     PC = addr;
+    check_idle_loop(branch);
 }
 
-void EOR_4D(BYTE op)
+ALWAYS_INLINE void EOR_4D(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_EOR(addr);
 }
 
-void LSR_4E(BYTE op)
+ALWAYS_INLINE void LSR_4E(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_LSR(addr);
 }
 
-void SRE_4F(BYTE op)
+ALWAYS_INLINE void SRE_4F(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_SRE(addr);
 }
 
-void BVC_50(BYTE op)
+ALWAYS_INLINE void BVC_50(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BVC(addr);
+    check_idle_loop(branch);
 }
 
-void EOR_51(BYTE op)
+ALWAYS_INLINE void EOR_51(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_EOR(addr);
 }
 
-void KIL_52(BYTE op)
+ALWAYS_INLINE void KIL_52(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void SRE_53(BYTE op)
+ALWAYS_INLINE void SRE_53(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_SRE(addr);
 }
 
-void DOP_54(BYTE op)
+ALWAYS_INLINE void DOP_54(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_DOP(addr);
 }
 
-void EOR_55(BYTE op)
+ALWAYS_INLINE void EOR_55(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_EOR(addr);
 }
 
-void LSR_56(BYTE op)
+ALWAYS_INLINE void LSR_56(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_LSR(addr);
 }
 
-void SRE_57(BYTE op)
+ALWAYS_INLINE void SRE_57(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_SRE(addr);
 }
 
-void CLI_58(BYTE op)
+ALWAYS_INLINE void CLI_58(BYTE op)
 {
     WORD addr = 0;
 
     handler_CLI(addr);
 }
 
-void EOR_59(BYTE op)
+ALWAYS_INLINE void EOR_59(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_EOR(addr);
 }
 
-void NOP_5A(BYTE op)
+ALWAYS_INLINE void NOP_5A(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_NOP(addr);
 }
 
-void SRE_5B(BYTE op)
+ALWAYS_INLINE void SRE_5B(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_SRE(addr);
 }
 
-void TOP_5C(BYTE op)
+ALWAYS_INLINE void TOP_5C(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_TOP(addr);
 }
 
-void EOR_5D(BYTE op)
+ALWAYS_INLINE void EOR_5D(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_EOR(addr);
 }
 
-void LSR_5E(BYTE op)
+ALWAYS_INLINE void LSR_5E(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_LSR(addr);
 }
 
-void SRE_5F(BYTE op)
+ALWAYS_INLINE void SRE_5F(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_SRE(addr);
 }
 
-void RTS_60(BYTE op)
+ALWAYS_INLINE void RTS_60(BYTE op)
 {
     WORD addr = 0;
 
     handler_RTS(addr);
 }
 
-void ADC_61(BYTE op)
+ALWAYS_INLINE void ADC_61(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_ADC(addr);
 }
 
-void KIL_62(BYTE op)
+ALWAYS_INLINE void KIL_62(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void RRA_63(BYTE op)
+ALWAYS_INLINE void RRA_63(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_RRA(addr);
 }
 
-void DOP_64(BYTE op)
+ALWAYS_INLINE void DOP_64(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_DOP(addr);
 }
 
-void ADC_65(BYTE op)
+ALWAYS_INLINE void ADC_65(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_ADC(addr);
 }
 
-void ROR_66(BYTE op)
+ALWAYS_INLINE void ROR_66(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_ROR(addr);
 }
 
-void RRA_67(BYTE op)
+ALWAYS_INLINE void RRA_67(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_RRA(addr);
 }
 
-void PLA_68(BYTE op)
+ALWAYS_INLINE void PLA_68(BYTE op)
 {
     WORD addr = 0;
 
     handler_PLA(addr);
 }
 
-void ADC_69(BYTE op)
+ALWAYS_INLINE void ADC_69(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -951,14 +1532,14 @@ void ADC_69(BYTE op)
     handler_ADC(addr);
 }
 
-void ROR_6A(BYTE op)
+ALWAYS_INLINE void ROR_6A(BYTE op)
 {
     WORD addr = 0;
 
     handler_ROR_REG_A(addr);
 }
 
-void ARR_6B(BYTE op)
+ALWAYS_INLINE void ARR_6B(BYTE op)
 {
     WORD addr = immediate_addressing();
 
@@ -967,147 +1548,153 @@ void ARR_6B(BYTE op)
     PC += 1;
 }
 
-void JMP_6C(BYTE op)
+ALWAYS_INLINE void JMP_6C(BYTE op)
 {
     WORD addr = indirect_addressing();
 
+    if (cdl_enabled) {
+        cdl_log_prg(addr, CDL_PRG_INDIRECT_CODE);
+    }
+
     PC = addr;
 }
 
-void ADC_6D(BYTE op)
+ALWAYS_INLINE void ADC_6D(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_ADC(addr);
 }
 
-void ROR_6E(BYTE op)
+ALWAYS_INLINE void ROR_6E(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_ROR(addr);
 }
 
-void RRA_6F(BYTE op)
+ALWAYS_INLINE void RRA_6F(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_RRA(addr);
 }
 
-void BVS_70(BYTE op)
+ALWAYS_INLINE void BVS_70(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BVS(addr);
+    check_idle_loop(branch);
 }
 
-void ADC_71(BYTE op)
+ALWAYS_INLINE void ADC_71(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_ADC(addr);
 }
 
-void KIL_72(BYTE op)
+ALWAYS_INLINE void KIL_72(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void RRA_73(BYTE op)
+ALWAYS_INLINE void RRA_73(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_RRA(addr);
 }
 
-void DOP_74(BYTE op)
+ALWAYS_INLINE void DOP_74(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_DOP(addr);
 }
 
-void ADC_75(BYTE op)
+ALWAYS_INLINE void ADC_75(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_ADC(addr);
 }
 
-void ROR_76(BYTE op)
+ALWAYS_INLINE void ROR_76(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_ROR(addr);
 }
 
-void RRA_77(BYTE op)
+ALWAYS_INLINE void RRA_77(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_RRA(addr);
 }
 
-void SEI_78(BYTE op)
+ALWAYS_INLINE void SEI_78(BYTE op)
 {
     WORD addr = 0;
 
     handler_SEI(addr);
 }
 
-void ADC_79(BYTE op)
+ALWAYS_INLINE void ADC_79(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_ADC(addr);
 }
 
-void NOP_7A(BYTE op)
+ALWAYS_INLINE void NOP_7A(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_NOP(addr);
 }
 
-void RRA_7B(BYTE op)
+ALWAYS_INLINE void RRA_7B(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_RRA(addr);
 }
 
-void TOP_7C(BYTE op)
+ALWAYS_INLINE void TOP_7C(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_TOP(addr);
 }
 
-void ADC_7D(BYTE op)
+ALWAYS_INLINE void ADC_7D(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_ADC(addr);
 }
 
-void ROR_7E(BYTE op)
+ALWAYS_INLINE void ROR_7E(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_ROR(addr);
 }
 
-void RRA_7F(BYTE op)
+ALWAYS_INLINE void RRA_7F(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_RRA(addr);
 }
 
-void DOP_80(BYTE op)
+ALWAYS_INLINE void DOP_80(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1115,14 +1702,14 @@ void DOP_80(BYTE op)
     handler_DOP(addr);
 }
 
-void STA_81(BYTE op)
+ALWAYS_INLINE void STA_81(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_STA(addr);
 }
 
-void DOP_82(BYTE op)
+ALWAYS_INLINE void DOP_82(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1130,49 +1717,49 @@ void DOP_82(BYTE op)
     handler_DOP(addr);
 }
 
-void AAX_83(BYTE op)
+ALWAYS_INLINE void AAX_83(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_AAX(addr);
 }
 
-void STY_84(BYTE op)
+ALWAYS_INLINE void STY_84(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_STY(addr);
 }
 
-void STA_85(BYTE op)
+ALWAYS_INLINE void STA_85(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_STA(addr);
 }
 
-void STX_86(BYTE op)
+ALWAYS_INLINE void STX_86(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_STX(addr);
 }
 
-void AAX_87(BYTE op)
+ALWAYS_INLINE void AAX_87(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_AAX(addr);
 }
 
-void DEY_88(BYTE op)
+ALWAYS_INLINE void DEY_88(BYTE op)
 {
     WORD addr = 0;
 
     handler_DEY(addr);
 }
 
-void DOP_89(BYTE op)
+ALWAYS_INLINE void DOP_89(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1180,141 +1767,143 @@ void DOP_89(BYTE op)
     handler_DOP(addr);
 }
 
-void TXA_8A(BYTE op)
+ALWAYS_INLINE void TXA_8A(BYTE op)
 {
     WORD addr = 0;
 
     handler_TXA(addr);
 }
 
-void STY_8C(BYTE op)
+ALWAYS_INLINE void STY_8C(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_STY(addr);
 }
 
-void XAA_8B(BYTE op)
+ALWAYS_INLINE void XAA_8B(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_XAA(addr);
 }
 
-void STA_8D(BYTE op)
+ALWAYS_INLINE void STA_8D(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_STA(addr);
 }
 
-void STX_8E(BYTE op)
+ALWAYS_INLINE void STX_8E(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_STX(addr);
 }
 
-void AAX_8F(BYTE op)
+ALWAYS_INLINE void AAX_8F(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_AAX(addr);
 }
 
-void BCC_90(BYTE op)
+ALWAYS_INLINE void BCC_90(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BCC(addr);
+    check_idle_loop(branch);
 }
 
-void STA_91(BYTE op)
+ALWAYS_INLINE void STA_91(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(1);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_STA(addr);
 }
 
-void KIL_92(BYTE op)
+ALWAYS_INLINE void KIL_92(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void AXA_93(BYTE op)
+ALWAYS_INLINE void AXA_93(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_AXA(addr);
 }
 
-void STY_94(BYTE op)
+ALWAYS_INLINE void STY_94(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     cpu_write(addr, cpu.Y);
 }
 
-void STA_95(BYTE op)
+ALWAYS_INLINE void STA_95(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_STA(addr);
 }
 
-void STX_96(BYTE op)
+ALWAYS_INLINE void STX_96(BYTE op)
 {
     WORD addr = zero_Y_indexed_addressing();
 
     handler_STX(addr);
 }
 
-void AAX_97(BYTE op)
+ALWAYS_INLINE void AAX_97(BYTE op)
 {
     WORD addr = zero_Y_indexed_addressing();
 
     handler_AAX(addr);
 }
 
-void TYA_98(BYTE op)
+ALWAYS_INLINE void TYA_98(BYTE op)
 {
     WORD addr = 0;
 
     handler_TYA(addr);
 }
 
-void STA_99(BYTE op)
+ALWAYS_INLINE void STA_99(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(1);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_STA(addr);
 }
 
-void TXS_9A(BYTE op)
+ALWAYS_INLINE void TXS_9A(BYTE op)
 {
     WORD addr = 0;
 
     handler_TXS(addr);
 }
 
-void XAS_9B(BYTE op)
+ALWAYS_INLINE void XAS_9B(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_XAS(addr);
 }
 
 //TODO: 暂时还没搞懂, 怎么实现的
-void SYA_9C(BYTE op)
+ALWAYS_INLINE void SYA_9C(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_SYA(addr);
 }
 
-void STA_9D(BYTE op)
+ALWAYS_INLINE void STA_9D(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
@@ -1322,21 +1911,21 @@ void STA_9D(BYTE op)
 }
 
 //TODO: 暂时还没搞懂, 怎么实现的
-void SXA_9E(BYTE op)
+ALWAYS_INLINE void SXA_9E(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_SXA(addr);
 }
 
-void AXA_9F(BYTE op)
+ALWAYS_INLINE void AXA_9F(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_AXA(addr);
 }
 
-void LDY_A0(BYTE op)
+ALWAYS_INLINE void LDY_A0(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1344,14 +1933,14 @@ void LDY_A0(BYTE op)
     handler_LDY(addr);
 }
 
-void LDA_A1(BYTE op)
+ALWAYS_INLINE void LDA_A1(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_LDA(addr);
 }
 
-void LDX_A2(BYTE op)
+ALWAYS_INLINE void LDX_A2(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1359,49 +1948,49 @@ void LDX_A2(BYTE op)
     handler_LDX(addr);
 }
 
-void LAX_A3(BYTE op)
+ALWAYS_INLINE void LAX_A3(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_LAX(addr);
 }
 
-void LDY_A4(BYTE op)
+ALWAYS_INLINE void LDY_A4(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_LDY(addr);
 }
 
-void LDA_A5(BYTE op)
+ALWAYS_INLINE void LDA_A5(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_LDA(addr);
 }
 
-void LDX_A6(BYTE op)
+ALWAYS_INLINE void LDX_A6(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_LDX(addr);
 }
 
-void LAX_A7(BYTE op)
+ALWAYS_INLINE void LAX_A7(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_LAX(addr);
 }
 
-void TAY_A8(BYTE op)
+ALWAYS_INLINE void TAY_A8(BYTE op)
 {
     WORD addr = 0;
 
     handler_TAY(addr);
 }
 
-void LDA_A9(BYTE op)
+ALWAYS_INLINE void LDA_A9(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1409,161 +1998,163 @@ void LDA_A9(BYTE op)
     handler_LDA(addr);
 }
 
-void TAX_AA(BYTE op)
+ALWAYS_INLINE void TAX_AA(BYTE op)
 {
     WORD addr = 0;
 
     handler_TAX(addr);
 }
 
-void ATX_AB(BYTE op)
+ALWAYS_INLINE void ATX_AB(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_ATX(addr);
 }
 
-void LDY_AC(BYTE op)
+ALWAYS_INLINE void LDY_AC(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_LDY(addr);
 }
 
-void LDA_AD(BYTE op)
+ALWAYS_INLINE void LDA_AD(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_LDA(addr);
 }
 
-void LDX_AE(BYTE op)
+ALWAYS_INLINE void LDX_AE(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_LDX(addr);
 }
 
-void LAX_AF(BYTE op)
+ALWAYS_INLINE void LAX_AF(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_LAX(addr);
 }
 
-void BCS_B0(BYTE op)
+ALWAYS_INLINE void BCS_B0(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BCS(addr);
+    check_idle_loop(branch);
 }
 
-void LDA_B1(BYTE op)
+ALWAYS_INLINE void LDA_B1(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_LDA(addr);
 }
 
-void KIL_B2(BYTE op)
+ALWAYS_INLINE void KIL_B2(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void LAX_B3(BYTE op)
+ALWAYS_INLINE void LAX_B3(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(1);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_LAX(addr);
 }
 
-void LDY_B4(BYTE op)
+ALWAYS_INLINE void LDY_B4(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_LDY(addr);
 }
 
-void LDA_B5(BYTE op)
+ALWAYS_INLINE void LDA_B5(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_LDA(addr);
 }
 
-void LDX_B6(BYTE op)
+ALWAYS_INLINE void LDX_B6(BYTE op)
 {
     WORD addr = zero_Y_indexed_addressing();
 
     handler_LDX(addr);
 }
 
-void LAX_B7(BYTE op)
+ALWAYS_INLINE void LAX_B7(BYTE op)
 {
     WORD addr = zero_Y_indexed_addressing();
 
     handler_LAX(addr);
 }
 
-void CLV_B8(BYTE op)
+ALWAYS_INLINE void CLV_B8(BYTE op)
 {
     WORD addr = 0;
 
     handler_CLV(addr);
 }
 
-void LDA_B9(BYTE op)
+ALWAYS_INLINE void LDA_B9(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_LDA(addr);
 }
 
-void TSX_BA(BYTE op)
+ALWAYS_INLINE void TSX_BA(BYTE op)
 {
     WORD addr = 0;
 
     handler_TSX(addr);
 }
 
-void LAR_BB(BYTE op)
+ALWAYS_INLINE void LAR_BB(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_LAR(addr);
 }
 
-void LDY_BC(BYTE op)
+ALWAYS_INLINE void LDY_BC(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_LDY(addr);
 }
 
-void LDA_BD(BYTE op)
+ALWAYS_INLINE void LDA_BD(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_LDA(addr);
 }
 
-void LDX_BE(BYTE op)
+ALWAYS_INLINE void LDX_BE(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_LDX(addr);
 }
 
-void LAX_BF(BYTE op)
+ALWAYS_INLINE void LAX_BF(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_LAX(addr);
 }
 
-void CPY_C0(BYTE op)
+ALWAYS_INLINE void CPY_C0(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1571,14 +2162,14 @@ void CPY_C0(BYTE op)
     handler_CPY(addr);
 }
 
-void CMP_C1(BYTE op)
+ALWAYS_INLINE void CMP_C1(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_CMP(addr);
 }
 
-void DOP_C2(BYTE op)
+ALWAYS_INLINE void DOP_C2(BYTE op)
 {
     WORD addr = immediate_addressing();
 
@@ -1587,49 +2178,49 @@ void DOP_C2(BYTE op)
     PC += 1;
 }
 
-void DCP_C3(BYTE op)
+ALWAYS_INLINE void DCP_C3(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_DCP(addr);
 }
 
-void CPY_C4(BYTE op)
+ALWAYS_INLINE void CPY_C4(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_CPY(addr);
 }
 
-void CMP_C5(BYTE op)
+ALWAYS_INLINE void CMP_C5(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_CMP(addr);
 }
 
-void DEC_C6(BYTE op)
+ALWAYS_INLINE void DEC_C6(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_DEC(addr);
 }
 
-void DCP_C7(BYTE op)
+ALWAYS_INLINE void DCP_C7(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_DCP(addr);
 }
 
-void INY_C8(BYTE op)
+ALWAYS_INLINE void INY_C8(BYTE op)
 {
     WORD addr = 0;
 
     handler_INY(addr);
 }
 
-void CMP_C9(BYTE op)
+ALWAYS_INLINE void CMP_C9(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1637,161 +2228,163 @@ void CMP_C9(BYTE op)
     handler_CMP(addr);
 }
 
-void DEX_CA(BYTE op)
+ALWAYS_INLINE void DEX_CA(BYTE op)
 {
     WORD addr = 0;
 
     handler_DEX(addr);
 }
 
-void AXS_CB(BYTE op)
+ALWAYS_INLINE void AXS_CB(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_AXS(addr);
 }
 
-void CPY_CC(BYTE op)
+ALWAYS_INLINE void CPY_CC(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_CPY(addr);
 }
 
-void CMP_CD(BYTE op)
+ALWAYS_INLINE void CMP_CD(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_CMP(addr);
 }
 
-void DEC_CE(BYTE op)
+ALWAYS_INLINE void DEC_CE(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_DEC(addr);
 }
 
-void DCP_CF(BYTE op)
+ALWAYS_INLINE void DCP_CF(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_DCP(addr);
 }
 
-void BNE_D0(BYTE op)
+ALWAYS_INLINE void BNE_D0(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BNE(addr);
+    check_idle_loop(branch);
 }
 
-void CMP_D1(BYTE op)
+ALWAYS_INLINE void CMP_D1(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_CMP(addr);
 }
 
-void KIL_D2(BYTE op)
+ALWAYS_INLINE void KIL_D2(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void DCP_D3(BYTE op)
+ALWAYS_INLINE void DCP_D3(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_DCP(addr);
 }
 
-void DOP_D4(BYTE op)
+ALWAYS_INLINE void DOP_D4(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_DOP(addr);
 }
 
-void CMP_D5(BYTE op)
+ALWAYS_INLINE void CMP_D5(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_CMP(addr);
 }
 
-void DEC_D6(BYTE op)
+ALWAYS_INLINE void DEC_D6(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_DEC(addr);
 }
 
-void DCP_D7(BYTE op)
+ALWAYS_INLINE void DCP_D7(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_DCP(addr);
 }
 
-void CLD_D8(BYTE op)
+ALWAYS_INLINE void CLD_D8(BYTE op)
 {
     WORD addr = 0;
 
     handler_CLD(addr);
 }
 
-void CMP_D9(BYTE op)
+ALWAYS_INLINE void CMP_D9(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_CMP(addr);
 }
 
-void NOP_DA(BYTE op)
+ALWAYS_INLINE void NOP_DA(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_NOP(addr);
 }
 
-void DCP_DB(BYTE op)
+ALWAYS_INLINE void DCP_DB(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_DCP(addr);
 }
 
-void TOP_DC(BYTE op)
+ALWAYS_INLINE void TOP_DC(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_TOP(addr);
 }
 
-void CMP_DD(BYTE op)
+ALWAYS_INLINE void CMP_DD(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_CMP(addr);
 }
 
-void DEC_DE(BYTE op)
+ALWAYS_INLINE void DEC_DE(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_DEC(addr);
 }
 
-void DCP_DF(BYTE op)
+ALWAYS_INLINE void DCP_DF(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_DCP(addr);
 }
 
-void CPX_E0(BYTE op)
+ALWAYS_INLINE void CPX_E0(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1799,14 +2392,14 @@ void CPX_E0(BYTE op)
     handler_CPX(addr);
 }
 
-void SBC_E1(BYTE op)
+ALWAYS_INLINE void SBC_E1(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_SBC(addr);
 }
 
-void DOP_E2(BYTE op)
+ALWAYS_INLINE void DOP_E2(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1814,49 +2407,49 @@ void DOP_E2(BYTE op)
     handler_DOP(addr);
 }
 
-void ISC_E3(BYTE op)
+ALWAYS_INLINE void ISC_E3(BYTE op)
 {
     WORD addr = indexed_X_indirect_addressing();
 
     handler_ISC(addr);
 }
 
-void CPX_E4(BYTE op)
+ALWAYS_INLINE void CPX_E4(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_CPX(addr);
 }
 
-void SBC_E5(BYTE op)
+ALWAYS_INLINE void SBC_E5(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_SBC(addr);
 }
 
-void INC_E6(BYTE op)
+ALWAYS_INLINE void INC_E6(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_INC(addr);
 }
 
-void ISC_E7(BYTE op)
+ALWAYS_INLINE void ISC_E7(BYTE op)
 {
     WORD addr = zero_absolute_addressing();
 
     handler_ISC(addr);
 }
 
-void INX_E8(BYTE op)
+ALWAYS_INLINE void INX_E8(BYTE op)
 {
     WORD addr = 0;
 
     handler_INX(addr);
 }
 
-void SBC_E9(BYTE op)
+ALWAYS_INLINE void SBC_E9(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1864,7 +2457,7 @@ void SBC_E9(BYTE op)
     handler_SBC(addr);
 }
 
-void NOP_EA(BYTE op)
+ALWAYS_INLINE void NOP_EA(BYTE op)
 {
     WORD addr = 0;
     handler_NOP(addr);
@@ -1872,7 +2465,7 @@ void NOP_EA(BYTE op)
     ++PC;
 }
 
-void SBC_EB(BYTE op)
+ALWAYS_INLINE void SBC_EB(BYTE op)
 {
     WORD addr = immediate_addressing();
     PC += 1;
@@ -1880,420 +2473,436 @@ void SBC_EB(BYTE op)
     handler_SBC(addr);
 }
 
-void CPX_EC(BYTE op)
+ALWAYS_INLINE void CPX_EC(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_CPX(addr);
 }
 
-void SBC_ED(BYTE op)
+ALWAYS_INLINE void SBC_ED(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_SBC(addr);
 }
 
-void INC_EE(BYTE op)
+ALWAYS_INLINE void INC_EE(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_INC(addr);
 }
 
-void ISC_EF(BYTE op)
+ALWAYS_INLINE void ISC_EF(BYTE op)
 {
     WORD addr = absolute_addressing();
 
     handler_ISC(addr);
 }
 
-void BEQ_F0(BYTE op)
+ALWAYS_INLINE void BEQ_F0(BYTE op)
 {
+    WORD branch = PC;
     WORD addr = relative_addressing();
 
     handler_BEQ(addr);
+    check_idle_loop(branch);
 }
 
-void SBC_F1(BYTE op)
+ALWAYS_INLINE void SBC_F1(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_SBC(addr);
 }
 
-void KIL_F2(BYTE op)
+ALWAYS_INLINE void KIL_F2(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_KIL(addr);
 }
 
-void ISC_F3(BYTE op)
+ALWAYS_INLINE void ISC_F3(BYTE op)
 {
-    WORD addr = indirect_Y_indexed_addressing(0);
+    WORD addr = indirect_Y_indexed_addressing(op);
 
     handler_ISC(addr);
 }
 
-void DOP_F4(BYTE op)
+ALWAYS_INLINE void DOP_F4(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_DOP(addr);
 }
 
-void SBC_F5(BYTE op)
+ALWAYS_INLINE void SBC_F5(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_SBC(addr);
 }
 
-void INC_F6(BYTE op)
+ALWAYS_INLINE void INC_F6(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_INC(addr);
 }
 
-void ISC_F7(BYTE op)
+ALWAYS_INLINE void ISC_F7(BYTE op)
 {
     WORD addr = zero_X_indexed_addressing();
 
     handler_ISC(addr);
 }
 
-void SED_F8(BYTE op)
+ALWAYS_INLINE void SED_F8(BYTE op)
 {
     WORD addr = 0;
 
     handler_SED(addr);
 }
 
-void SBC_F9(BYTE op)
+ALWAYS_INLINE void SBC_F9(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_SBC(addr);
 }
 
-void NOP_FA(BYTE op)
+ALWAYS_INLINE void NOP_FA(BYTE op)
 {
     WORD addr = immediate_addressing();
 
     handler_NOP(addr);
 }
 
-void ISC_FB(BYTE op)
+ALWAYS_INLINE void ISC_FB(BYTE op)
 {
-    WORD addr = absolute_Y_indexed_addressing(0);
+    WORD addr = absolute_Y_indexed_addressing(op);
 
     handler_ISC(addr);
 }
 
-void TOP_FC(BYTE op)
+ALWAYS_INLINE void TOP_FC(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_TOP(addr);
 }
 
-void SBC_FD(BYTE op)
+ALWAYS_INLINE void SBC_FD(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_SBC(addr);
 }
 
-void INC_FE(BYTE op)
+ALWAYS_INLINE void INC_FE(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_INC(addr);
 }
 
-void ISC_FF(BYTE op)
+ALWAYS_INLINE void ISC_FF(BYTE op)
 {
     WORD addr = absolute_X_indexed_addressing(op);
 
     handler_ISC(addr);
 }
 
-static void init_code()
-{
-    op(00, "BRK", 1, 7, BRK_00)
-    op(01, "ORA", 2, 6, ORA_01)
-    op(02, "KIL", 1, 0, KIL_02)
-    op(03, "SLO", 2, 8, SLO_03)
-    op(04, "DOP", 2, 3, DOP_04)
-    op(05, "ORA", 2, 3, ORA_05)
-    op(06, "ASL", 2, 5, ASL_06)
-    op(07, "SLO", 2, 5, SLO_07)
-    op(08, "PHP", 1, 3, PHP_08)
-    op(09, "ORA", 2, 2, ORA_09)
-    op(0A, "ASL", 1, 2, ASL_0A)
-    op(0B, "AAC", 2, 2, AAC_0B)
-    op(0C, "TOP", 3, 4, NOP_0C)
-    op(0D, "ORA", 3, 4, ORA_0D)
-    op(0E, "ASL", 3, 6, ASL_0E)
-    op(0F, "SLO", 3, 6, SLO_0F)
-
-    op(10, "BPL", 2, 2, BPL_10)
-    op(11, "ORA", 2, 5, ORA_11)
-    op(12, "KIL", 1, 0, KIL_12)
-    op(13, "SLO", 2, 7, SLO_13)
-    op(14, "DOP", 2, 4, DOP_14)
-    op(15, "ORA", 2, 4, ORA_15)
-    op(16, "ASL", 2, 6, ASL_16)
-    op(17, "SLO", 2, 6, SLO_17)
-    op(18, "CLC", 1, 2, CLC_18)
-    op(19, "ORA", 3, 4, ORA_19)
-    op(1A, "NOP", 1, 2, NOP_1A)
-    op(1B, "SLO", 3, 6, SLO_1B)
-    op(1C, "TOP", 3, 4, TOP_1C)
-    op(1D, "ORA", 3, 4, ORA_1D)
-    op(1E, "ASL", 3, 7, ASL_1E)
-    op(1F, "SLO", 3, 7, SLO_1F)
-
-    op(20, "JSR", 3, 6, JSR_20)
-    op(21, "AND", 2, 6, AND_21)
-    op(22, "KIL", 1, 0, KIL_22)
-    op(23, "RLA", 2, 8, RLA_23)
-    op(24, "BIT", 2, 3, BIT_24)
-    op(25, "AND", 2, 3, AND_25)
-    op(26, "ROL", 2, 5, ROL_26)
-    op(27, "RLA", 2, 5, RLA_27)
-    op(28, "PLP", 1, 4, PLP_28)
-    op(29, "AND", 2, 2, AND_29)
-    op(2A, "ROL", 1, 2, ROL_2A)
-    op(2B, "ROL", 1, 2, AAC_2B)
-    op(2C, "BIT", 3, 4, BIT_2C)
-    op(2D, "AND", 3, 4, AND_2D)
-    op(2E, "ROL", 3, 6, ROL_2E)
-    op(2F, "RLA", 3, 6, RLA_2F)
-
-    op(30, "BMI", 2, 2, BMI_30)
-    op(31, "AND", 2, 5, AND_31)
-    op(32, "KIL", 1, 0, KIL_32)
-    op(33, "RLA", 2, 7, RLA_33)
-    op(34, "DOP", 2, 4, DOP_34)
-    op(35, "AND", 2, 4, AND_35)
-    op(36, "ROL", 2, 6, ROL_36)
-    op(37, "RLA", 2, 6, RLA_37)
-    op(38, "SEC", 1, 2, SEC_38)
-    op(39, "AND", 3, 4, AND_39)
-    op(3A, "NOP", 1, 2, NOP_3A)
-    op(3B, "RLA", 3, 6, RLA_3B)
-    op(3C, "TOP", 3, 4, TOP_3C)
-    op(3D, "AND", 3, 4, AND_3D)
-    op(3E, "ROL", 3, 7, ROL_3E)
-    op(3F, "RLA", 3, 7, RLA_3F)
-
-    op(40, "RTI", 1, 6, RTI_40)
-    op(41, "EOR", 2, 6, EOR_41)
-    op(42, "KIL", 1, 0, KIL_42)
-    op(43, "SRE", 2, 8, SRE_43)
-    op(44, "DOP", 2, 3, DOP_44)
-    op(45, "EOR", 2, 3, EOR_45)
-    op(46, "LSR", 2, 5, LSR_46)
-    op(47, "SRE", 2, 5, SRE_47)
-    op(48, "PHA", 1, 3, PHA_48)
-    op(49, "EOR", 2, 2, EOR_49)
-    op(4A, "LSR", 1, 2, LSR_4A)
-    op(4B, "ASR", 2, 2, ASR_4B)
-    op(4C, "JMP", 3, 3, JMP_4C)
-    op(4D, "EOR", 3, 4, EOR_4D)
-    op(4E, "LSR", 3, 6, LSR_4E)
-    op(4F, "SRE", 3, 6, SRE_4F)
-
-    op(50, "BVC", 2, 2, BVC_50)
-    op(51, "EOR", 2, 5, EOR_51)
-    op(52, "KIL", 1, 0, KIL_52)
-    op(53, "SRE", 2, 7, SRE_53)
-    op(54, "DOP", 2, 4, DOP_54)
-    op(55, "EOR", 2, 4, EOR_55)
-    op(56, "LSR", 2, 6, LSR_56)
-    op(57, "SRE", 2, 6, SRE_57)
-    op(58, "CLI", 1, 2, CLI_58)
-    op(59, "EOR", 3, 4, EOR_59)
-    op(5A, "NOP", 1, 2, NOP_5A)
-    op(5B, "SRE", 3, 6, SRE_5B)
-    op(5C, "TOP", 3, 4, TOP_5C)
-    op(5D, "EOR", 3, 4, EOR_5D)
-    op(5E, "LSR", 3, 7, LSR_5E)
-    op(5F, "SRE", 3, 7, SRE_5F)
-
-    op(60, "RTS", 1, 6, RTS_60)
-    op(61, "ADC", 2, 6, ADC_61)
-    op(62, "KIL", 1, 0, KIL_62)
-    op(63, "RRA", 2, 8, RRA_63)
-    op(64, "DOP", 2, 3, DOP_64)
-    op(65, "ADC", 2, 3, ADC_65)
-    op(66, "ROR", 2, 5, ROR_66)
-    op(67, "RRA", 2, 5, RRA_67)
-    op(68, "PLA", 1, 4, PLA_68)
-    op(69, "ADC", 2, 2, ADC_69)
-    op(6A, "ROR", 1, 2, ROR_6A)
-    op(6B, "ARR", 2, 2, ARR_6B)
-    op(6C, "JMP", 3, 5, JMP_6C)
-    op(6D, "ADC", 3, 4, ADC_6D)
-    op(6E, "ROR", 3, 6, ROR_6E)
-    op(6F, "RRA", 3, 6, RRA_6F)
-
-    op(70, "BVS", 2, 2, BVS_70)
-    op(71, "ADC", 2, 5, ADC_71)
-    op(72, "KIL", 1, 0, KIL_72)
-    op(73, "RRA", 2, 7, RRA_73)
-    op(74, "DOP", 2, 4, DOP_74)
-    op(75, "ADC", 2, 4, ADC_75)
-    op(76, "ROR", 3, 6, ROR_76)
-    op(77, "RRA", 2, 6, RRA_77)
-    op(78, "SEI", 1, 2, SEI_78)
-    op(79, "ADC", 3, 4, ADC_79)
-    op(7A, "NOP", 1, 2, NOP_7A)
-    op(7B, "RRA", 3, 6, RRA_7B)
-    op(7C, "TOP", 3, 4, TOP_7C)
-    op(7D, "ADC", 3, 4, ADC_7D)
-    op(7E, "ROR", 3, 7, ROR_7E)
-    op(7F, "RRA", 3, 7, RRA_7F)
-
-    op(80, "DOP", 2, 2, DOP_80)
-    op(81, "STA", 2, 6, STA_81)
-    op(82, "DOP", 2, 2, DOP_82)
-    op(83, "SAX", 2, 6, AAX_83)
-    op(84, "STY", 2, 3, STY_84)
-    op(85, "STA", 2, 3, STA_85)
-    op(86, "STX", 2, 3, STX_86)
-    op(87, "SAX", 2, 3, AAX_87)
-    op(88, "DEY", 1, 2, DEY_88)
-    op(89, "DOP", 2, 2, DOP_89)
-    op(8A, "TXA", 1, 2, TXA_8A)
-    op(8B, "XAA", 2, 2, XAA_8B)
-    op(8C, "STY", 3, 4, STY_8C)
-    op(8D, "STA", 3, 4, STA_8D)
-    op(8E, "STX", 3, 4, STX_8E)
-    op(8F, "SAX", 3, 4, AAX_8F)
-
-    op(90, "BCC", 2, 2, BCC_90)
-    op(91, "STA", 2, 6, STA_91)
-    op(92, "KIL", 1, 0, KIL_92)
-    op(93, "AXA", 2, 6, AXA_93)
-    op(94, "STY", 2, 4, STY_94)
-    op(95, "STA", 2, 4, STA_95)
-    op(96, "STX", 2, 4, STX_96)
-    op(97, "SAX", 2, 4, AAX_97)
-    op(98, "TYA", 1, 2, TYA_98)
-    op(99, "STA", 3, 5, STA_99)
-    op(9A, "TXS", 1, 2, TXS_9A)
-    op(9B, "XAS", 3, 5, XAS_9B)
-    op(9C, "SYA", 3, 5, SYA_9C)
-    op(9D, "STA", 3, 5, STA_9D)
-    op(9E, "SXA", 3, 5, SXA_9E)
-    op(9F, "AXA", 3, 5, AXA_9F)
-
-    op(A0, "LDY", 2, 2, LDY_A0)
-    op(A1, "LDA", 2, 6, LDA_A1)
-    op(A2, "LDX", 2, 2, LDX_A2)
-    op(A3, "LAX", 2, 6, LAX_A3)
-    op(A4, "LDY", 2, 3, LDY_A4)
-    op(A5, "LDA", 2, 3, LDA_A5)
-    op(A6, "LDX", 2, 3, LDX_A6)
-    op(A7, "LAX", 2, 3, LAX_A7)
-    op(A8, "TAY", 1, 2, TAY_A8)
-    op(A9, "LDA", 2, 2, LDA_A9)
-    op(AA, "TAX", 1, 2, TAX_AA)
-    op(AB, "ATX", 2, 2, ATX_AB)
-    op(AC, "LDY", 3, 4, LDY_AC)
-    op(AD, "LDA", 3, 4, LDA_AD)
-    op(AE, "LDX", 3, 4, LDX_AE)
-    op(AF, "LAX", 3, 4, LAX_AF)
-
-    op(B0, "BCS", 2, 2, BCS_B0)
-    op(B1, "LDA", 2, 5, LDA_B1)
-    op(B2, "KIL", 1, 0, KIL_B2)
-    op(B3, "LAX", 2, 5, LAX_B3)
-    op(B4, "LDY", 2, 4, LDY_B4)
-    op(B5, "LDA", 2, 4, LDA_B5)
-    op(B6, "LDX", 2, 4, LDX_B6)
-    op(B7, "LAX", 2, 4, LAX_B7)
-    op(B8, "CLV", 1, 2, CLV_B8)
-    op(B9, "LDA", 3, 4, LDA_B9)
-    op(BA, "TSX", 1, 2, TSX_BA)
-    op(BB, "LAR", 3, 4, LAR_BB)
-    op(BC, "LDY", 3, 4, LDY_BC)
-    op(BD, "LDA", 3, 4, LDA_BD)
-    op(BE, "LDX", 3, 4, LDX_BE)
-    op(BF, "LAX", 3, 4, LAX_BF)
-
-    op(C0, "CPY", 2, 2, CPY_C0)
-    op(C1, "CMP", 2, 6, CMP_C1)
-    op(C2, "DOP", 2, 2, DOP_C2)
-    op(C3, "DCP", 2, 8, DCP_C3)
-    op(C4, "CPY", 2, 3, CPY_C4)
-    op(C5, "CMP", 2, 3, CMP_C5)
-    op(C6, "DEC", 2, 5, DEC_C6)
-    op(C7, "DCP", 2, 5, DCP_C7)
-    op(C8, "INY", 1, 2, INY_C8)
-    op(C9, "CMP", 2, 2, CMP_C9)
-    op(CA, "DEX", 1, 2, DEX_CA)
-    op(CB, "AXS", 2, 2, AXS_CB)
-    op(CC, "CPY", 3, 4, CPY_CC)
-    op(CD, "CMP", 3, 4, CMP_CD)
-    op(CE, "DEC", 3, 6, DEC_CE)
-    op(CF, "DCP", 3, 6, DCP_CF)
-
-    op(D0, "BNE", 2, 2, BNE_D0)
-    op(D1, "CMP", 2, 5, CMP_D1)
-    op(D2, "KIL", 1, 0, KIL_D2)
-    op(D3, "DCP", 2, 7, DCP_D3)
-    op(D4, "DOP", 2, 4, DOP_D4)
-    op(D5, "CMP", 2, 4, CMP_D5)
-    op(D6, "DEC", 2, 6, DEC_D6)
-    op(D7, "DCP", 2, 6, DCP_D7)
-    op(D8, "CLD", 1, 2, CLD_D8)
-    op(D9, "CMP", 3, 4, CMP_D9)
-    op(DA, "NOP", 1, 2, NOP_DA)
-    op(DB, "DCP", 1, 6, DCP_DB)
-    op(DC, "TOP", 3, 4, TOP_DC)
-    op(DD, "CMP", 3, 4, CMP_DD)
-    op(DE, "DEC", 3, 7, DEC_DE)
-    op(DF, "DCP", 3, 7, DCP_DF)
-
-    op(E0, "CPX", 2, 2, CPX_E0)
-    op(E1, "SBC", 2, 6, SBC_E1)
-    op(E2, "DOP", 2, 6, DOP_E2)
-    op(E3, "ISC", 2, 8, ISC_E3)
-    op(E4, "CPX", 2, 3, CPX_E4)
-    op(E5, "SBC", 2, 3, SBC_E5)
-    op(E6, "INC", 2, 5, INC_E6)
-    op(E7, "ISC", 2, 5, ISC_E7)
-    op(E8, "INX", 1, 2, INX_E8)
-    op(E9, "SBC", 2, 2, SBC_E9)
-    op(EA, "NOP", 1, 2, NOP_EA)
-    op(EB, "SBC", 2, 2, SBC_EB)
-    op(EC, "CPX", 3, 4, CPX_EC)
-    op(ED, "SBC", 3, 4, SBC_ED)
-    op(EE, "INC", 3, 6, INC_EE)
-    op(EF, "ISC", 3, 6, ISC_EF)
-
-    op(F0, "BEQ", 2, 2, BEQ_F0)
-    op(F1, "SBC", 2, 5, SBC_F1)
-    op(F2, "KIL", 1, 0, KIL_F2)
-    op(F3, "ISC", 2, 7, ISC_F3)
-    op(F4, "DOP", 2, 4, DOP_F4)
-    op(F5, "SBC", 2, 4, SBC_F5)
-    op(F6, "INC", 2, 6, INC_F6)
-    op(F7, "ISC", 2, 6, ISC_F7)
-    op(F8, "SED", 1, 2, SED_F8)
-    op(F9, "SBC", 3, 4, SBC_F9)
-    op(FA, "NOP", 1, 2, NOP_FA)
-    op(FB, "ISC", 3, 6, ISC_FB)
-    op(FC, "TOP", 3, 4, TOP_FC)
-    op(FD, "SBC", 3, 4, SBC_FD)
-    op(FE, "INC", 3, 7, INC_FE)
-    op(FF, "ISC", 3, 7, ISC_FF)
-}
+// 操作码表: op(编码, 助记符, 指令长度, 周期数, 寻址方式, 执行函数)
+#define OPCODE_TABLE(op) \
+    op(00, "BRK", 1, 7, IMP, BRK_00) \
+    op(01, "ORA", 2, 6, IZX, ORA_01) \
+    op(02, "KIL", 1, 0, IMP, KIL_02) \
+    op(03, "SLO", 2, 8, IZX, SLO_03) \
+    op(04, "DOP", 2, 3, ZP, DOP_04) \
+    op(05, "ORA", 2, 3, ZP, ORA_05) \
+    op(06, "ASL", 2, 5, ZP, ASL_06) \
+    op(07, "SLO", 2, 5, ZP, SLO_07) \
+    op(08, "PHP", 1, 3, IMP, PHP_08) \
+    op(09, "ORA", 2, 2, IMM, ORA_09) \
+    op(0A, "ASL", 1, 2, ACC, ASL_0A) \
+    op(0B, "AAC", 2, 2, IMM, AAC_0B) \
+    op(0C, "TOP", 3, 4, ABS, NOP_0C) \
+    op(0D, "ORA", 3, 4, ABS, ORA_0D) \
+    op(0E, "ASL", 3, 6, ABS, ASL_0E) \
+    op(0F, "SLO", 3, 6, ABS, SLO_0F) \
+    \
+    op(10, "BPL", 2, 2, REL, BPL_10) \
+    op(11, "ORA", 2, 5, IZY, ORA_11) \
+    op(12, "KIL", 1, 0, IMP, KIL_12) \
+    op(13, "SLO", 2, 8, IZY, SLO_13) \
+    op(14, "DOP", 2, 4, ZPX, DOP_14) \
+    op(15, "ORA", 2, 4, ZPX, ORA_15) \
+    op(16, "ASL", 2, 6, ZPX, ASL_16) \
+    op(17, "SLO", 2, 6, ZPX, SLO_17) \
+    op(18, "CLC", 1, 2, IMP, CLC_18) \
+    op(19, "ORA", 3, 4, ABY, ORA_19) \
+    op(1A, "NOP", 1, 2, IMP, NOP_1A) \
+    op(1B, "SLO", 3, 7, ABY, SLO_1B) \
+    op(1C, "TOP", 3, 4, ABX, TOP_1C) \
+    op(1D, "ORA", 3, 4, ABX, ORA_1D) \
+    op(1E, "ASL", 3, 7, ABX, ASL_1E) \
+    op(1F, "SLO", 3, 7, ABX, SLO_1F) \
+    \
+    op(20, "JSR", 3, 6, ABS, JSR_20) \
+    op(21, "AND", 2, 6, IZX, AND_21) \
+    op(22, "KIL", 1, 0, IMP, KIL_22) \
+    op(23, "RLA", 2, 8, IZX, RLA_23) \
+    op(24, "BIT", 2, 3, ZP, BIT_24) \
+    op(25, "AND", 2, 3, ZP, AND_25) \
+    op(26, "ROL", 2, 5, ZP, ROL_26) \
+    op(27, "RLA", 2, 5, ZP, RLA_27) \
+    op(28, "PLP", 1, 4, IMP, PLP_28) \
+    op(29, "AND", 2, 2, IMM, AND_29) \
+    op(2A, "ROL", 1, 2, ACC, ROL_2A) \
+    op(2B, "AAC", 2, 2, IMM, AAC_2B) \
+    op(2C, "BIT", 3, 4, ABS, BIT_2C) \
+    op(2D, "AND", 3, 4, ABS, AND_2D) \
+    op(2E, "ROL", 3, 6, ABS, ROL_2E) \
+    op(2F, "RLA", 3, 6, ABS, RLA_2F) \
+    \
+    op(30, "BMI", 2, 2, REL, BMI_30) \
+    op(31, "AND", 2, 5, IZY, AND_31) \
+    op(32, "KIL", 1, 0, IMP, KIL_32) \
+    op(33, "RLA", 2, 8, IZY, RLA_33) \
+    op(34, "DOP", 2, 4, ZPX, DOP_34) \
+    op(35, "AND", 2, 4, ZPX, AND_35) \
+    op(36, "ROL", 2, 6, ZPX, ROL_36) \
+    op(37, "RLA", 2, 6, ZPX, RLA_37) \
+    op(38, "SEC", 1, 2, IMP, SEC_38) \
+    op(39, "AND", 3, 4, ABY, AND_39) \
+    op(3A, "NOP", 1, 2, IMP, NOP_3A) \
+    op(3B, "RLA", 3, 7, ABY, RLA_3B) \
+    op(3C, "TOP", 3, 4, ABX, TOP_3C) \
+    op(3D, "AND", 3, 4, ABX, AND_3D) \
+    op(3E, "ROL", 3, 7, ABX, ROL_3E) \
+    op(3F, "RLA", 3, 7, ABX, RLA_3F) \
+    \
+    op(40, "RTI", 1, 6, IMP, RTI_40) \
+    op(41, "EOR", 2, 6, IZX, EOR_41) \
+    op(42, "KIL", 1, 0, IMP, KIL_42) \
+    op(43, "SRE", 2, 8, IZX, SRE_43) \
+    op(44, "DOP", 2, 3, ZP, DOP_44) \
+    op(45, "EOR", 2, 3, ZP, EOR_45) \
+    op(46, "LSR", 2, 5, ZP, LSR_46) \
+    op(47, "SRE", 2, 5, ZP, SRE_47) \
+    op(48, "PHA", 1, 3, IMP, PHA_48) \
+    op(49, "EOR", 2, 2, IMM, EOR_49) \
+    op(4A, "LSR", 1, 2, ACC, LSR_4A) \
+    op(4B, "ASR", 2, 2, IMM, ASR_4B) \
+    op(4C, "JMP", 3, 3, ABS, JMP_4C) \
+    op(4D, "EOR", 3, 4, ABS, EOR_4D) \
+    op(4E, "LSR", 3, 6, ABS, LSR_4E) \
+    op(4F, "SRE", 3, 6, ABS, SRE_4F) \
+    \
+    op(50, "BVC", 2, 2, REL, BVC_50) \
+    op(51, "EOR", 2, 5, IZY, EOR_51) \
+    op(52, "KIL", 1, 0, IMP, KIL_52) \
+    op(53, "SRE", 2, 8, IZY, SRE_53) \
+    op(54, "DOP", 2, 4, ZPX, DOP_54) \
+    op(55, "EOR", 2, 4, ZPX, EOR_55) \
+    op(56, "LSR", 2, 6, ZPX, LSR_56) \
+    op(57, "SRE", 2, 6, ZPX, SRE_57) \
+    op(58, "CLI", 1, 2, IMP, CLI_58) \
+    op(59, "EOR", 3, 4, ABY, EOR_59) \
+    op(5A, "NOP", 1, 2, IMP, NOP_5A) \
+    op(5B, "SRE", 3, 7, ABY, SRE_5B) \
+    op(5C, "TOP", 3, 4, ABX, TOP_5C) \
+    op(5D, "EOR", 3, 4, ABX, EOR_5D) \
+    op(5E, "LSR", 3, 7, ABX, LSR_5E) \
+    op(5F, "SRE", 3, 7, ABX, SRE_5F) \
+    \
+    op(60, "RTS", 1, 6, IMP, RTS_60) \
+    op(61, "ADC", 2, 6, IZX, ADC_61) \
+    op(62, "KIL", 1, 0, IMP, KIL_62) \
+    op(63, "RRA", 2, 8, IZX, RRA_63) \
+    op(64, "DOP", 2, 3, ZP, DOP_64) \
+    op(65, "ADC", 2, 3, ZP, ADC_65) \
+    op(66, "ROR", 2, 5, ZP, ROR_66) \
+    op(67, "RRA", 2, 5, ZP, RRA_67) \
+    op(68, "PLA", 1, 4, IMP, PLA_68) \
+    op(69, "ADC", 2, 2, IMM, ADC_69) \
+    op(6A, "ROR", 1, 2, ACC, ROR_6A) \
+    op(6B, "ARR", 2, 2, IMM, ARR_6B) \
+    op(6C, "JMP", 3, 5, IND, JMP_6C) \
+    op(6D, "ADC", 3, 4, ABS, ADC_6D) \
+    op(6E, "ROR", 3, 6, ABS, ROR_6E) \
+    op(6F, "RRA", 3, 6, ABS, RRA_6F) \
+    \
+    op(70, "BVS", 2, 2, REL, BVS_70) \
+    op(71, "ADC", 2, 5, IZY, ADC_71) \
+    op(72, "KIL", 1, 0, IMP, KIL_72) \
+    op(73, "RRA", 2, 8, IZY, RRA_73) \
+    op(74, "DOP", 2, 4, ZPX, DOP_74) \
+    op(75, "ADC", 2, 4, ZPX, ADC_75) \
+    op(76, "ROR", 2, 6, ZPX, ROR_76) \
+    op(77, "RRA", 2, 6, ZPX, RRA_77) \
+    op(78, "SEI", 1, 2, IMP, SEI_78) \
+    op(79, "ADC", 3, 4, ABY, ADC_79) \
+    op(7A, "NOP", 1, 2, IMP, NOP_7A) \
+    op(7B, "RRA", 3, 7, ABY, RRA_7B) \
+    op(7C, "TOP", 3, 4, ABX, TOP_7C) \
+    op(7D, "ADC", 3, 4, ABX, ADC_7D) \
+    op(7E, "ROR", 3, 7, ABX, ROR_7E) \
+    op(7F, "RRA", 3, 7, ABX, RRA_7F) \
+    \
+    op(80, "DOP", 2, 2, IMM, DOP_80) \
+    op(81, "STA", 2, 6, IZX, STA_81) \
+    op(82, "DOP", 2, 2, IMM, DOP_82) \
+    op(83, "SAX", 2, 6, IZX, AAX_83) \
+    op(84, "STY", 2, 3, ZP, STY_84) \
+    op(85, "STA", 2, 3, ZP, STA_85) \
+    op(86, "STX", 2, 3, ZP, STX_86) \
+    op(87, "SAX", 2, 3, ZP, AAX_87) \
+    op(88, "DEY", 1, 2, IMP, DEY_88) \
+    op(89, "DOP", 2, 2, IMM, DOP_89) \
+    op(8A, "TXA", 1, 2, IMP, TXA_8A) \
+    op(8B, "XAA", 2, 2, IMM, XAA_8B) \
+    op(8C, "STY", 3, 4, ABS, STY_8C) \
+    op(8D, "STA", 3, 4, ABS, STA_8D) \
+    op(8E, "STX", 3, 4, ABS, STX_8E) \
+    op(8F, "SAX", 3, 4, ABS, AAX_8F) \
+    \
+    op(90, "BCC", 2, 2, REL, BCC_90) \
+    op(91, "STA", 2, 6, IZY, STA_91) \
+    op(92, "KIL", 1, 0, IMP, KIL_92) \
+    op(93, "AXA", 2, 6, IZY, AXA_93) \
+    op(94, "STY", 2, 4, ZPX, STY_94) \
+    op(95, "STA", 2, 4, ZPX, STA_95) \
+    op(96, "STX", 2, 4, ZPY, STX_96) \
+    op(97, "SAX", 2, 4, ZPY, AAX_97) \
+    op(98, "TYA", 1, 2, IMP, TYA_98) \
+    op(99, "STA", 3, 5, ABY, STA_99) \
+    op(9A, "TXS", 1, 2, IMP, TXS_9A) \
+    op(9B, "XAS", 3, 5, ABY, XAS_9B) \
+    op(9C, "SYA", 3, 5, ABX, SYA_9C) \
+    op(9D, "STA", 3, 5, ABX, STA_9D) \
+    op(9E, "SXA", 3, 5, ABY, SXA_9E) \
+    op(9F, "AXA", 3, 5, ABY, AXA_9F) \
+    \
+    op(A0, "LDY", 2, 2, IMM, LDY_A0) \
+    op(A1, "LDA", 2, 6, IZX, LDA_A1) \
+    op(A2, "LDX", 2, 2, IMM, LDX_A2) \
+    op(A3, "LAX", 2, 6, IZX, LAX_A3) \
+    op(A4, "LDY", 2, 3, ZP, LDY_A4) \
+    op(A5, "LDA", 2, 3, ZP, LDA_A5) \
+    op(A6, "LDX", 2, 3, ZP, LDX_A6) \
+    op(A7, "LAX", 2, 3, ZP, LAX_A7) \
+    op(A8, "TAY", 1, 2, IMP, TAY_A8) \
+    op(A9, "LDA", 2, 2, IMM, LDA_A9) \
+    op(AA, "TAX", 1, 2, IMP, TAX_AA) \
+    op(AB, "ATX", 2, 2, IMM, ATX_AB) \
+    op(AC, "LDY", 3, 4, ABS, LDY_AC) \
+    op(AD, "LDA", 3, 4, ABS, LDA_AD) \
+    op(AE, "LDX", 3, 4, ABS, LDX_AE) \
+    op(AF, "LAX", 3, 4, ABS, LAX_AF) \
+    \
+    op(B0, "BCS", 2, 2, REL, BCS_B0) \
+    op(B1, "LDA", 2, 5, IZY, LDA_B1) \
+    op(B2, "KIL", 1, 0, IMP, KIL_B2) \
+    op(B3, "LAX", 2, 5, IZY, LAX_B3) \
+    op(B4, "LDY", 2, 4, ZPX, LDY_B4) \
+    op(B5, "LDA", 2, 4, ZPX, LDA_B5) \
+    op(B6, "LDX", 2, 4, ZPY, LDX_B6) \
+    op(B7, "LAX", 2, 4, ZPY, LAX_B7) \
+    op(B8, "CLV", 1, 2, IMP, CLV_B8) \
+    op(B9, "LDA", 3, 4, ABY, LDA_B9) \
+    op(BA, "TSX", 1, 2, IMP, TSX_BA) \
+    op(BB, "LAR", 3, 4, ABY, LAR_BB) \
+    op(BC, "LDY", 3, 4, ABX, LDY_BC) \
+    op(BD, "LDA", 3, 4, ABX, LDA_BD) \
+    op(BE, "LDX", 3, 4, ABY, LDX_BE) \
+    op(BF, "LAX", 3, 4, ABY, LAX_BF) \
+    \
+    op(C0, "CPY", 2, 2, IMM, CPY_C0) \
+    op(C1, "CMP", 2, 6, IZX, CMP_C1) \
+    op(C2, "DOP", 2, 2, IMM, DOP_C2) \
+    op(C3, "DCP", 2, 8, IZX, DCP_C3) \
+    op(C4, "CPY", 2, 3, ZP, CPY_C4) \
+    op(C5, "CMP", 2, 3, ZP, CMP_C5) \
+    op(C6, "DEC", 2, 5, ZP, DEC_C6) \
+    op(C7, "DCP", 2, 5, ZP, DCP_C7) \
+    op(C8, "INY", 1, 2, IMP, INY_C8) \
+    op(C9, "CMP", 2, 2, IMM, CMP_C9) \
+    op(CA, "DEX", 1, 2, IMP, DEX_CA) \
+    op(CB, "AXS", 2, 2, IMM, AXS_CB) \
+    op(CC, "CPY", 3, 4, ABS, CPY_CC) \
+    op(CD, "CMP", 3, 4, ABS, CMP_CD) \
+    op(CE, "DEC", 3, 6, ABS, DEC_CE) \
+    op(CF, "DCP", 3, 6, ABS, DCP_CF) \
+    \
+    op(D0, "BNE", 2, 2, REL, BNE_D0) \
+    op(D1, "CMP", 2, 5, IZY, CMP_D1) \
+    op(D2, "KIL", 1, 0, IMP, KIL_D2) \
+    op(D3, "DCP", 2, 8, IZY, DCP_D3) \
+    op(D4, "DOP", 2, 4, ZPX, DOP_D4) \
+    op(D5, "CMP", 2, 4, ZPX, CMP_D5) \
+    op(D6, "DEC", 2, 6, ZPX, DEC_D6) \
+    op(D7, "DCP", 2, 6, ZPX, DCP_D7) \
+    op(D8, "CLD", 1, 2, IMP, CLD_D8) \
+    op(D9, "CMP", 3, 4, ABY, CMP_D9) \
+    op(DA, "NOP", 1, 2, IMP, NOP_DA) \
+    op(DB, "DCP", 3, 7, ABY, DCP_DB) \
+    op(DC, "TOP", 3, 4, ABX, TOP_DC) \
+    op(DD, "CMP", 3, 4, ABX, CMP_DD) \
+    op(DE, "DEC", 3, 7, ABX, DEC_DE) \
+    op(DF, "DCP", 3, 7, ABX, DCP_DF) \
+    \
+    op(E0, "CPX", 2, 2, IMM, CPX_E0) \
+    op(E1, "SBC", 2, 6, IZX, SBC_E1) \
+    op(E2, "DOP", 2, 6, IMM, DOP_E2) \
+    op(E3, "ISC", 2, 8, IZX, ISC_E3) \
+    op(E4, "CPX", 2, 3, ZP, CPX_E4) \
+    op(E5, "SBC", 2, 3, ZP, SBC_E5) \
+    op(E6, "INC", 2, 5, ZP, INC_E6) \
+    op(E7, "ISC", 2, 5, ZP, ISC_E7) \
+    op(E8, "INX", 1, 2, IMP, INX_E8) \
+    op(E9, "SBC", 2, 2, IMM, SBC_E9) \
+    op(EA, "NOP", 1, 2, IMP, NOP_EA) \
+    op(EB, "SBC", 2, 2, IMM, SBC_EB) \
+    op(EC, "CPX", 3, 4, ABS, CPX_EC) \
+    op(ED, "SBC", 3, 4, ABS, SBC_ED) \
+    op(EE, "INC", 3, 6, ABS, INC_EE) \
+    op(EF, "ISC", 3, 6, ABS, ISC_EF) \
+    \
+    op(F0, "BEQ", 2, 2, REL, BEQ_F0) \
+    op(F1, "SBC", 2, 5, IZY, SBC_F1) \
+    op(F2, "KIL", 1, 0, IMP, KIL_F2) \
+    op(F3, "ISC", 2, 8, IZY, ISC_F3) \
+    op(F4, "DOP", 2, 4, ZPX, DOP_F4) \
+    op(F5, "SBC", 2, 4, ZPX, SBC_F5) \
+    op(F6, "INC", 2, 6, ZPX, INC_F6) \
+    op(F7, "ISC", 2, 6, ZPX, ISC_F7) \
+    op(F8, "SED", 1, 2, IMP, SED_F8) \
+    op(F9, "SBC", 3, 4, ABY, SBC_F9) \
+    op(FA, "NOP", 1, 2, IMP, NOP_FA) \
+    op(FB, "ISC", 3, 7, ABY, ISC_FB) \
+    op(FC, "TOP", 3, 4, ABX, TOP_FC) \
+    op(FD, "SBC", 3, 4, ABX, SBC_FD) \
+    op(FE, "INC", 3, 7, ABX, INC_FE) \
+    op(FF, "ISC", 3, 7, ABX, ISC_FF)
+
+/*
+* 只有读操作才会因为变址跨页多花一个周期, 写和读改写的周期数里已经算上了.
+* 表里读操作的周期数: 绝对变址 4, 间接 Y 变址 5
+*/
+#define PAGE_CROSS(m, p) \
+    (((ADDR_##m == ADDR_ABX || ADDR_##m == ADDR_ABY) && p < 5) || (ADDR_##m == ADDR_IZY && p < 6))
+
+#define OP_ENTRY(c, s, n, p, m, func) \
+    [0x##c] = { n, s, p, ADDR_##m, PAGE_CROSS(m, p), func },
+
+const INS code_maps[0X100] = { OPCODE_TABLE(OP_ENTRY) };
+
+#undef OP_ENTRY
+#undef PAGE_CROSS
 
 static void init_reg()
 {
@@ -2301,10 +2910,12 @@ static void init_reg()
     cpu.SP = 0xFD;
     cpu.X = 0;
     cpu.Y = 0;
-    cpu.P = 0x24;
+    cpu_set_status(0x24);
     cpu.A = 0;
     cpu.is_lock = 0;
     cpu.cycle = 8;
+
+    cpu_sync_reset();
 }
 
 // 读取复位向量的函数
@@ -2336,14 +2947,24 @@ uint16_t get_irq_vector()
 
 void cpu_init()
 {
-    init_code();
+#ifdef CPU_FUSION_STATS
+    static BYTE registered = 0;
+    if (!registered) {
+        atexit(print_fusion_stats);
+        registered = 1;
+    }
+#endif
 
     init_reg();
+    decode_cache_reset();
+    idle_loop_reset();
 }
 
 void cpu_reset()
 {
     init_reg();
+    decode_cache_reset();
+    idle_loop_reset();
 }
 
 void cpu_interrupt_NMI()
@@ -2353,7 +2974,7 @@ void cpu_interrupt_NMI()
     push(cpu.IP & 0xFF);  // 低字节
 
     // 将 P 状态寄存器压栈（清除 B 标志）
-    push(cpu.P & ~0x30);  // 清除 B 和未使用标志（位 4 和位 5）
+    push(cpu_get_status() & ~0x30);  // 清除 B 和未使用标志（位 4 和位 5）
 
     // 设置禁用中断标志
     cpu.P |= 0x04;
@@ -2365,9 +2986,15 @@ void cpu_interrupt_NMI()
     cpu.IP = nmi_vector;
     cpu_clock();
 
+    if (call_profile_enabled) {
+        call_profiler_enter(nmi_vector, CALL_NMI);
+    }
+
     // 清除NMI 标志
     cpu.interrupt &= 0xFE;
     cpu_clock();
+
+    idle_loop.valid = 0;
 }
 
 void cpu_interrupt_IRQ()
@@ -2381,10 +3008,16 @@ void cpu_interrupt_IRQ()
 
     cpu.IP = get_irq_vector();
 
+    if (call_profile_enabled) {
+        call_profiler_enter(cpu.IP, CALL_IRQ);
+    }
+
     // 清除IRQ 标志
     cpu.interrupt &= 0xFD;
 
     cpu_clock();
+
+    idle_loop.valid = 0;
 }
 
 BYTE cpu_read_byte(WORD address)
@@ -2427,39 +3060,457 @@ void set_irq()
     cpu.interrupt |= 0x2;
 }
 
-BYTE step_cpu()
+// 指令执行完后, 补全剩下的 cycle, 跨页和分支跳转的周期加在表里的周期数之上
+ALWAYS_INLINE void finish_instruction(uint64_t start_cycle, uint32_t instr_cycle)
 {
-    // 初始的周期数
-    int initial_cycles = cpu.cycle;
+    instr_cycle += cpu.extra_cycles;
+    cpu.extra_cycles = 0;
+
+    if (cpu.cycle - start_cycle < instr_cycle) {
+        cpu.cycle = start_cycle + instr_cycle;
+    }
+}
+
+// 融合的前一条执行完, 下一条能不能接着执行: 不能越过同步点、中断和 cpu_run 的终点
+static inline int can_run_fused()
+{
+    return cpu.cycle < next_sync_cycle && cpu.cycle < block_end_cycle && !cpu.interrupt;
+}
+
+static inline void execute_fused_pair(const DECODED_INS *entry, BYTE first, void (*first_func)(BYTE),
+    BYTE second, void (*second_func)(BYTE))
+{
+    uint64_t start_cycle = cpu.cycle;
+
+    first_func(first);
+    finish_instruction(start_cycle, code_maps[first].cycle);
+
+    if (!can_run_fused()) {
+        current_entry = NULL;
+        return;
+    }
+
+#ifdef CPU_FUSION_STATS
+    fusion_counts[entry->fusion]++;
+#endif
+    count_opcode_pair(second);
+
+    current_entry = entry + code_maps[first].op_len;
+    start_cycle = cpu.cycle;
+
+    if (cdl_enabled) {
+        cdl_log_entry(current_entry);
+    }
+
+    second_func(second);
+    finish_instruction(start_cycle, code_maps[second].cycle);
+
+    current_entry = NULL;
+}
+
+#ifdef CPU_BATCH_VERIFY
+
+static _CPU cpu_before;
+
+// 对比模式: 恢复现场后用解释器逐条执行, 检查每条指令之间的检查是不是真的可以省掉
+static void verify_batch(const DECODED_INS *entry)
+{
+    static _CPU cpu_after;
+
+    memcpy(&cpu_after, &cpu, sizeof(_CPU));
+
+    memcpy(&cpu, &cpu_before, sizeof(_CPU));
+    for (int i = 0; i < entry->batch; i++) {
+        uint64_t start_cycle = cpu.cycle;
+        BYTE opcode = fetch_opcode();
+
+        current_entry->op_func(opcode);
+        finish_instruction(start_cycle, code_maps[opcode].cycle);
+    }
+    current_entry = NULL;
+
+    if (memcmp(&cpu_after, &cpu, sizeof(_CPU))) {
+        fprintf(stderr, "batch mismatch, block %04X (%d instructions)\n", cpu_before.IP, entry->batch);
+        fprintf(stderr, "  batch:  PC:%04X A:%02X X:%02X Y:%02X P:%02X NVZC:%02X %02X %02X %02X SP:%02X CYC:%" PRIu64 "\n",
+            cpu_after.IP, cpu_after.A, cpu_after.X, cpu_after.Y, cpu_after.P,
+            cpu_after.flag_n, cpu_after.flag_v, cpu_after.flag_z, cpu_after.flag_c, cpu_after.SP, cpu_after.cycle);
+        fprintf(stderr, "  interp: PC:%04X A:%02X X:%02X Y:%02X P:%02X NVZC:%02X %02X %02X %02X SP:%02X CYC:%" PRIu64 "\n",
+            cpu.IP, cpu.A, cpu.X, cpu.Y, cpu.P, cpu.flag_n, cpu.flag_v, cpu.flag_z, cpu.flag_c, cpu.SP, cpu.cycle);
+        exit(-1);
+    }
+}
+
+#endif
+
+// 整段都能在同步点和 cpu_run 的终点之前执行完时才成批执行, 返回 1
+static inline int execute_batch(const DECODED_INS *entry)
+{
+    uint64_t end_cycle = cpu.cycle + entry->batch_cycles;
+
+    if (end_cycle > next_sync_cycle || end_cycle > block_end_cycle || cpu.interrupt) {
+        return 0;
+    }
+
+#ifdef CPU_BATCH_VERIFY
+    memcpy(&cpu_before, &cpu, sizeof(_CPU));
+#endif
+
+    const DECODED_INS *first = entry;
+
+    for (int i = 0; i < first->batch; i++) {
+        // 第一条在取指时已经统计过
+        if (i) {
+            count_opcode_pair(entry->opcode);
+
+            if (cdl_enabled) {
+                cdl_log_entry(entry);
+            }
+        }
+
+        current_entry = entry;
+        entry->op_func(entry->opcode);
+        entry += code_maps[entry->opcode].op_len;
+    }
+
+    // 每条指令实际走的周期都不超过表里的周期数, 补齐之后就是整段的总和
+    cpu.cycle = end_cycle;
+    current_entry = NULL;
+
+#ifdef CPU_BATCH_VERIFY
+    verify_batch(first);
+#endif
+
+    return 1;
+}
+
+// current_entry 是融合的前一条, 执行完整个指令对(或者只有前一条)
+static void execute_fusion(const DECODED_INS *entry)
+{
+#define FUSION_EXEC(a, fa, b, fb) \
+    case FUSION_##a##_##b: execute_fused_pair(entry, 0x##a, fa, 0x##b, fb); break;
+
+    switch (entry->fusion) {
+        FUSION_TABLE(FUSION_EXEC)
+    }
+
+#undef FUSION_EXEC
+}
+
+// 命中预解码缓存的指令先试着成批执行, 再试融合, 都不行时返回 0 按单条执行
+static int execute_block(const DECODED_INS *entry)
+{
+    if (entry->batch > 1 && execute_batch(entry)) {
+        return 1;
+    }
+
+    if (entry->fusion) {
+        execute_fusion(entry);
+        return 1;
+    }
+
+    return 0;
+}
+
+// 取指之前的检查: 到了同步点先让 PPU/APU 追上来, 有中断就处理中断并返回 1
+static inline int poll_events()
+{
+    if (cpu.cycle >= next_sync_cycle) {
+        cpu_sync();
+    }
 
     //触发NMI 中断, 直接执行读取中断向量操作
     if (cpu.interrupt & 0x1) {
         cpu_interrupt_NMI();
-        return cpu.cycle - initial_cycles;
+        return 1;
     }
 
     if (cpu.interrupt & 0x2) {
         cpu_interrupt_IRQ();
-        return cpu.cycle - initial_cycles;
+        return 1;
     }
 
-    BYTE opcode = bus_read(PC);
+    return 0;
+}
 
-    uint32_t start_cycle = cpu.cycle;
+#ifdef CPU_JIT
 
-    // 执行操作码对应的操作函数
-    uint32_t instr_cycle = code_maps[opcode].cycle;
-    code_maps[opcode].op_func(opcode);
+// PC 处的热点块交给 jit 执行, 块内每条指令都必须在 limit_cycle 和下一个同步点之前开始
+static inline int try_jit(uint64_t limit_cycle)
+{
+    // jit 块里的指令不经过取指, 记录代码时不用 jit
+    if (cdl_enabled) {
+        return 0;
+    }
 
-    // 补全剩下的cycle
-    uint32_t end_cycle = cpu.cycle;
-    while (instr_cycle > (end_cycle - start_cycle)) {
-        cpu_clock();
-        instr_cycle -= 1;
+    if (next_sync_cycle < limit_cycle) {
+        limit_cycle = next_sync_cycle;
+    }
+
+    DECODED_INS *entry = decode_lookup(PC);
+
+    return entry && jit_execute(entry, limit_cycle);
+}
+
+#else
+
+static inline int try_jit(uint64_t limit_cycle)
+{
+    (void)limit_cycle;
+    return 0;
+}
+
+#endif
+
+static uint32_t cpu_single_step_until(uint64_t end_cycle);
+
+#ifdef CPU_THREADED_DISPATCH
+
+/*
+* 单循环解释器: 每个操作码一个分支, 不再经过 code_maps 的函数指针.
+* 执行函数、寻址函数和 handler.h 里的操作都是 ALWAYS_INLINE,
+* 会整个展开到对应的分支里, 周期数在编译期就是常量.
+* GCC 下用 computed goto, 其它编译器退回 switch, 能否内联取决于编译器
+*/
+#define OP_CASE(c, s, n, p, m, func) \
+    case 0x##c: func(0x##c); finish_instruction(start_cycle, p); break;
+
+static inline void execute_opcode(BYTE opcode)
+{
+    uint64_t start_cycle = cpu.cycle;
+
+    count_opcode_pair(opcode);
+
+    if (current_entry && execute_block(current_entry)) {
+        return;
+    }
+
+    switch (opcode) {
+        OPCODE_TABLE(OP_CASE)
+    }
+
+    current_entry = NULL;
+}
+
+uint32_t cpu_run_until(uint64_t end_cycle)
+{
+    uint64_t initial_cycles = cpu.cycle;
+
+    if (trace_enabled || debug_enabled) {
+        return cpu_single_step_until(end_cycle);
+    }
+
+    run_end_cycle = end_cycle;
+    block_end_cycle = end_cycle;
+
+#if defined(__GNUC__)
+
+#define OP_LABEL(c, s, n, p, m, func) [0x##c] = &&op_##c,
+#define OP_BODY(c, s, n, p, m, func) \
+    op_##c: func(0x##c); finish_instruction(start_cycle, p); current_entry = NULL; DISPATCH();
+
+// 每个操作码的末尾各自跳转到下一条指令
+#define DISPATCH() \
+    do { \
+        if (cpu.cycle >= end_cycle) goto done; \
+        if (poll_events() || try_jit(end_cycle)) goto next; \
+        opcode = fetch_opcode(); \
+        count_opcode_pair(opcode); \
+        if (current_entry && execute_block(current_entry)) { \
+            goto next; \
+        } \
+        start_cycle = cpu.cycle; \
+        goto *labels[opcode]; \
+    } while (0)
+
+    static const void *labels[0x100] = { OPCODE_TABLE(OP_LABEL) };
+    uint64_t start_cycle;
+    BYTE opcode;
+
+next:
+    DISPATCH();
+
+    OPCODE_TABLE(OP_BODY)
+
+done:
+
+#undef DISPATCH
+#undef OP_BODY
+#undef OP_LABEL
+
+#else
+
+    while (cpu.cycle < end_cycle) {
+        if (poll_events() || try_jit(end_cycle)) {
+            continue;
+        }
+
+        execute_opcode(fetch_opcode());
+    }
+
+#endif
+
+    return cpu.cycle - initial_cycles;
+}
+
+#else
+
+static inline void execute_opcode(BYTE opcode)
+{
+    uint64_t start_cycle = cpu.cycle;
+
+    count_opcode_pair(opcode);
+
+    // 执行操作码对应的操作函数, 命中预解码缓存时不用再查 code_maps
+    if (current_entry && execute_block(current_entry)) {
+        return;
+    }
+
+    if (current_entry) {
+        current_entry->op_func(opcode);
+        finish_instruction(start_cycle, current_entry->cycle);
+    } else {
+        code_maps[opcode].op_func(opcode);
+        finish_instruction(start_cycle, code_maps[opcode].cycle);
+    }
+
+    current_entry = NULL;
+}
+
+uint32_t cpu_run_until(uint64_t end_cycle)
+{
+    uint64_t initial_cycles = cpu.cycle;
+
+    if (trace_enabled || debug_enabled) {
+        return cpu_single_step_until(end_cycle);
+    }
+
+    run_end_cycle = end_cycle;
+    block_end_cycle = end_cycle;
+
+    while (cpu.cycle < end_cycle) {
+        if (poll_events() || try_jit(end_cycle)) {
+            continue;
+        }
+
+        execute_opcode(fetch_opcode());
+    }
+
+    return cpu.cycle - initial_cycles;
+}
+
+#endif
+
+// 记录一条指令之前先让 ppu 追上来, 记下的扫描线和点才是这条指令开始时的
+static inline void trace_next_instruction()
+{
+    cpu_sync();
+    trace_instruction();
+}
+
+/*
+* 打开跟踪或者设置了断点时逐条执行: 不走 jit, 不成批执行也不融合, 也不跳过空转循环,
+* 每条指令都要记录下来, 每条指令之前都要检查执行断点. 停在断点上时直接返回
+*/
+static uint32_t cpu_single_step_until(uint64_t end_cycle)
+{
+    uint64_t initial_cycles = cpu.cycle;
+
+    run_end_cycle = 0;
+    block_end_cycle = 0;
+
+    while (cpu.cycle < end_cycle && !debug_paused) {
+        if (poll_events()) {
+            continue;
+        }
+
+        if (debug_enabled && debug_check_exec()) {
+            break;
+        }
+
+        if (trace_enabled) {
+            trace_next_instruction();
+        }
+
+        execute_opcode(fetch_opcode());
+
+        if (debug_enabled) {
+            debug_instruction_done();
+        }
+    }
+
+    return cpu.cycle - initial_cycles;
+}
+
+uint32_t cpu_run(uint32_t cycles)
+{
+    return cpu_run_until(cpu.cycle + cycles);
+}
+
+// 执行到 ppu 把这一帧送去显示(240, 1) 之后第一条指令的边界, 返回消耗的周期数
+uint32_t cpu_run_frame()
+{
+    // 先同步, ppu 的位置才是当前周期的
+    cpu_sync();
+
+    int dots = ppu_dots_to_frame_end();
+    uint32_t cycles = cpu_run_until(cpu.cycle + (dots + PPU_DOTS_PER_CPU_CYCLE - 1) / PPU_DOTS_PER_CPU_CYCLE);
+
+    // 返回之前让 ppu 追上来, 这一帧已经显示出去了
+    cpu_sync();
+
+    return cycles;
+}
+
+uint32_t step_cpu()
+{
+    // 初始的周期数
+    uint64_t initial_cycles = cpu.cycle;
+
+    if (trace_enabled || debug_enabled) {
+        // 只执行一条指令或者进入一次中断
+        cpu_single_step_until(cpu.cycle + 1);
+    } else if (!poll_events() && !try_jit(next_sync_cycle)) {
+        run_end_cycle = next_sync_cycle;
+        block_end_cycle = 0;
+        execute_opcode(fetch_opcode());
     }
 
     // 计算指令消耗的实际周期数
-    int cycles_consumed = cpu.cycle - initial_cycles;
+    return cpu.cycle - initial_cycles;
+}
+
+#ifdef CPU_JIT
+
+DECODED_INS *cpu_decode(WORD address)
+{
+    return decode_lookup(address);
+}
+
+// jit 块里没有翻译成本地代码的指令, 按解释器的方式执行
+void cpu_execute_entry(const DECODED_INS *entry)
+{
+    uint64_t start_cycle = cpu.cycle;
 
-    return cycles_consumed;
+    current_entry = entry;
+    entry->op_func(entry->opcode);
+    finish_instruction(start_cycle, entry->cycle);
+    current_entry = NULL;
 }
+
+// 不检查中断, 解释执行 PC 处的一条指令, 用来和 jit 的结果对比
+void cpu_interpret_instruction()
+{
+    uint64_t end_cycle = block_end_cycle;
+
+    // 只执行一条, 不能和下一条融合
+    block_end_cycle = 0;
+    execute_opcode(fetch_opcode());
+    block_end_cycle = end_cycle;
+}
+
+int cpu_is_idle_loop(WORD target, WORD branch)
+{
+    return analyze_idle_loop(target, branch) != IDLE_LOOP_NONE;
+}
+
+#endif
@@ -3,27 +3,70 @@
 #include "common.h"
 
 #define OP_LEN (8)
+
+// 寻址方式
+enum
+{
+    ADDR_IMP, // 隐含
+    ADDR_ACC, // 累加器
+    ADDR_IMM, // 立即数
+    ADDR_ZP,  // 零页
+    ADDR_ZPX, // 零页 X 变址
+    ADDR_ZPY, // 零页 Y 变址
+    ADDR_ABS, // 绝对
+    ADDR_ABX, // 绝对 X 变址
+    ADDR_ABY, // 绝对 Y 变址
+    ADDR_IND, // 间接
+    ADDR_IZX, // X 变址间接
+    ADDR_IZY, // 间接 Y 变址
+    ADDR_REL, // 相对
+};
+
 typedef struct
 {
     char op_len;
-    char *op_name;
+    const char *op_name;
     char cycle;
+    BYTE mode;       // 寻址方式
+    BYTE page_cross; // 变址跨页时多一个周期
 
     //对应代码的执行函数
     void (*op_func)(BYTE);
 }INS;
 
-extern INS code_maps[0X100];
+// 操作码表在编译期生成, 只读
+extern const INS code_maps[0X100];
+
+// PRG-ROM 的预解码项
+typedef struct
+{
+    void (*op_func)(BYTE);
+    WORD operand;
+    BYTE opcode;
+    BYTE cycle;
+    BYTE state;
+    BYTE fusion; // 和紧跟着的下一条指令合并执行的编号, 0 表示不合并
+    BYTE batch;  // 从这条开始可以成批执行的指令数, 0 表示还没有计算
+    BYTE batch_cycles;
+
+#ifdef CPU_JIT
+    WORD hits;   // 解释执行的次数, 到了阈值就编译成本地代码
+    void *block; // 以这条指令开头的 jit 块
+#endif
+}DECODED_INS;
+
+void cpu_invalidate_decode_cache();
+
+#ifdef CPU_JIT
+DECODED_INS *cpu_decode(WORD address);
+void cpu_execute_entry(const DECODED_INS *entry);
+void cpu_interpret_instruction();
+int cpu_is_idle_loop(WORD target, WORD branch);
+#endif
 
 BYTE cpu_read_byte(WORD address);
 void cpu_write_byte(WORD address, BYTE data);
 WORD cpu_read_word(WORD address);
 void cpu_write_word(WORD address, WORD data);
 
-#define op(c, s, n, p, func) \
-    code_maps[0x##c].op_name = s; \
-    code_maps[0x##c].op_len = n; \
-    code_maps[0x##c].cycle = p; \
-    code_maps[0x##c].op_func = func; \
-
 #endif
\ No newline at end of file
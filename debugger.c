@@ -0,0 +1,363 @@
+#include "debugger.h"
+#include "memory.h"
+#include "cpu.h"
+#include "disasm.h"
+
+typedef struct
+{
+    BYTE used;
+    BYTE type;  // DEBUG_EXEC/DEBUG_READ/DEBUG_WRITE 的组合
+    WORD start;
+    WORD end;   // 包含 end
+    DEBUG_CONDITION condition;
+    uint32_t hits;
+}DEBUG_POINT;
+
+// 最近一次停下来的原因
+typedef struct
+{
+    int id;       // -1 表示单步
+    BYTE type;
+    WORD address;
+    BYTE value;
+    WORD pc;      // 命中的那条指令的地址
+}DEBUG_HIT;
+
+BYTE debug_enabled = 0;
+BYTE debug_paused = 0;
+
+static DEBUG_POINT debug_points[DEBUG_POINT_MAX];
+static BYTE exec_pages[0x100];          // 有执行断点的页
+static BYTE debug_skip_exec = 0;        // 从执行断点继续时, 停在上面的这条指令不再触发
+static BYTE debug_single_step = 0;
+static WORD debug_instruction_pc = 0;
+static DEBUG_HIT debug_hit;
+
+// 地址是否在断点范围内, 内部 RAM 每 2KB 镜像一次, $0000-$1FFF 的地址按 & 0x07FF 折叠后的每个镜像都算
+static int point_contains(const DEBUG_POINT *point, WORD address)
+{
+    if (address >= 0x2000) {
+        return address >= point->start && address <= point->end;
+    }
+
+    for (WORD mirror = address & 0x07FF; mirror < 0x2000; mirror += 0x0800) {
+        if (mirror >= point->start && mirror <= point->end) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// 重新计算要从总线页表里拿掉的页, RAM 的页折叠到 $00-$07 以后再标到所有镜像上
+static void update_watch_pages()
+{
+    BYTE read_pages[0x100] = {0};
+    BYTE write_pages[0x100] = {0};
+    BYTE enabled = 0;
+
+    memset(exec_pages, 0, sizeof(exec_pages));
+
+    for (int i = 0; i < DEBUG_POINT_MAX; i++) {
+        const DEBUG_POINT *point = &debug_points[i];
+        if (!point->used) {
+            continue;
+        }
+
+        enabled = 1;
+        for (int page = point->start >> 8; page <= point->end >> 8; page++) {
+            int folded = page < 0x20 ? page & 0x07 : page;
+            exec_pages[folded] |= point->type & DEBUG_EXEC;
+            read_pages[folded] |= point->type & DEBUG_READ;
+            write_pages[folded] |= point->type & DEBUG_WRITE;
+        }
+    }
+
+    for (int page = 0x08; page < 0x20; page++) {
+        exec_pages[page] = exec_pages[page & 0x07];
+        read_pages[page] = read_pages[page & 0x07];
+        write_pages[page] = write_pages[page & 0x07];
+    }
+
+    bus_set_watch_pages(read_pages, write_pages);
+    debug_enabled = enabled;
+}
+
+int debug_add_point(BYTE type, WORD start, WORD end, const DEBUG_CONDITION *condition)
+{
+    if (!type || end < start) {
+        return -1;
+    }
+
+    for (int i = 0; i < DEBUG_POINT_MAX; i++) {
+        DEBUG_POINT *point = &debug_points[i];
+        if (point->used) {
+            continue;
+        }
+
+        memset(point, 0, sizeof(DEBUG_POINT));
+        point->used = 1;
+        point->type = type;
+        point->start = start;
+        point->end = end;
+        if (condition) {
+            point->condition = *condition;
+        }
+
+        update_watch_pages();
+        return i;
+    }
+
+    fprintf(stderr, "too many breakpoints!\n");
+    return -1;
+}
+
+void debug_remove_point(int id)
+{
+    if (id < 0 || id >= DEBUG_POINT_MAX) {
+        return;
+    }
+
+    debug_points[id].used = 0;
+    update_watch_pages();
+
+    if (!debug_enabled) {
+        debug_paused = 0;
+    }
+}
+
+void debug_clear_points()
+{
+    memset(debug_points, 0, sizeof(debug_points));
+    update_watch_pages();
+    debug_paused = 0;
+}
+
+static int parse_register(const char *text, BYTE *reg)
+{
+    static const struct { const char *name; BYTE reg; } names[] = {
+        { "SP", DEBUG_REG_SP }, { "A", DEBUG_REG_A }, { "X", DEBUG_REG_X },
+        { "Y", DEBUG_REG_Y }, { "P", DEBUG_REG_P },
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (!strncmp(text, names[i].name, strlen(names[i].name))) {
+            *reg = names[i].reg;
+            return strlen(names[i].name);
+        }
+    }
+
+    return 0;
+}
+
+static int parse_operator(const char *text, BYTE *op)
+{
+    if (!strncmp(text, "==", 2)) { *op = DEBUG_OP_EQ; return 2; }
+    if (!strncmp(text, "!=", 2)) { *op = DEBUG_OP_NE; return 2; }
+    if (text[0] == '=') { *op = DEBUG_OP_EQ; return 1; }
+    if (text[0] == '<') { *op = DEBUG_OP_LT; return 1; }
+    if (text[0] == '>') { *op = DEBUG_OP_GT; return 1; }
+
+    return 0;
+}
+
+/*
+* 文本形式的断点: 类型:地址[-地址][:条件], 数值都是十六进制
+* 类型是 x(执行)、r(读)、w(写) 的组合, 条件是寄存器(A/X/Y/P/SP) 加 ==、!=、<、> 和数值
+* 例如 x:C000、w:0300-03FF、rw:2002:A==80, 成功时返回编号, 格式错误返回 -1
+*/
+int debug_add_spec(const char *spec)
+{
+    BYTE type = 0;
+    const char *pos = spec;
+
+    for (; *pos && *pos != ':'; pos++) {
+        switch (*pos) {
+            case 'x': type |= DEBUG_EXEC; break;
+            case 'r': type |= DEBUG_READ; break;
+            case 'w': type |= DEBUG_WRITE; break;
+            default: return -1;
+        }
+    }
+
+    if (*pos++ != ':') {
+        return -1;
+    }
+
+    char *end = NULL;
+    unsigned long start = strtoul(pos, &end, 16);
+    unsigned long last = start;
+    if (end == pos || start > 0xFFFF) {
+        return -1;
+    }
+
+    if (*end == '-') {
+        pos = end + 1;
+        last = strtoul(pos, &end, 16);
+        if (end == pos || last > 0xFFFF) {
+            return -1;
+        }
+    }
+
+    DEBUG_CONDITION condition = { DEBUG_REG_NONE, DEBUG_OP_EQ, 0 };
+    if (*end == ':') {
+        pos = end + 1;
+
+        int length = parse_register(pos, &condition.reg);
+        if (!length) {
+            return -1;
+        }
+        pos += length;
+
+        length = parse_operator(pos, &condition.op);
+        if (!length) {
+            return -1;
+        }
+        pos += length;
+
+        unsigned long value = strtoul(pos, &end, 16);
+        if (end == pos || value > 0xFF) {
+            return -1;
+        }
+        condition.value = value;
+    }
+
+    if (*end) {
+        return -1;
+    }
+
+    return debug_add_point(type, start, last, &condition);
+}
+
+static int check_condition(const DEBUG_CONDITION *condition)
+{
+    BYTE value;
+
+    switch (condition->reg) {
+        case DEBUG_REG_A: value = cpu.A; break;
+        case DEBUG_REG_X: value = cpu.X; break;
+        case DEBUG_REG_Y: value = cpu.Y; break;
+        case DEBUG_REG_P: value = cpu_get_status(); break;
+        case DEBUG_REG_SP: value = cpu.SP; break;
+        default: return 1;
+    }
+
+    switch (condition->op) {
+        case DEBUG_OP_NE: return value != condition->value;
+        case DEBUG_OP_LT: return value < condition->value;
+        case DEBUG_OP_GT: return value > condition->value;
+        default: return value == condition->value;
+    }
+}
+
+static void debug_break(int id, BYTE type, WORD address, BYTE value)
+{
+    if (id >= 0) {
+        debug_points[id].hits++;
+    }
+
+    debug_hit.id = id;
+    debug_hit.type = type;
+    debug_hit.address = address;
+    debug_hit.value = value;
+    debug_hit.pc = debug_instruction_pc;
+
+    debug_paused = 1;
+}
+
+// 停下来时打印原因、寄存器和下一条要执行的指令
+static void debug_report()
+{
+    BYTE code[3];
+    char text[32];
+
+    for (int i = 0; i < 3; i++) {
+        code[i] = bus_peek(PC + i);
+    }
+    disassemble_bytes(PC, code, text, sizeof(text));
+
+    if (debug_hit.id < 0) {
+        fprintf(stderr, "step\n");
+    } else if (debug_hit.type == DEBUG_EXEC) {
+        fprintf(stderr, "breakpoint #%d at $%04X\n", debug_hit.id, debug_hit.address);
+    } else {
+        fprintf(stderr, "watchpoint #%d: %s $%04X = %02X by $%04X\n", debug_hit.id,
+            debug_hit.type == DEBUG_READ ? "read" : "write", debug_hit.address, debug_hit.value, debug_hit.pc);
+    }
+
+    fprintf(stderr, "  %04X  %-16s A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%" PRIu64 "\n",
+        PC, text, cpu.A, cpu.X, cpu.Y, cpu_get_status(), cpu.SP, cpu.cycle);
+}
+
+// 继续运行, 停在执行断点上时先执行这条指令
+void debug_continue()
+{
+    debug_skip_exec = debug_hit.type == DEBUG_EXEC;
+    debug_paused = 0;
+}
+
+// 执行一条指令后再停下来
+void debug_step()
+{
+    debug_single_step = 1;
+    debug_continue();
+}
+
+// 指令开始之前调用, 命中执行断点时返回 1, 这条指令不执行
+int debug_check_exec()
+{
+    debug_instruction_pc = PC;
+
+    if (debug_skip_exec) {
+        debug_skip_exec = 0;
+        return 0;
+    }
+
+    if (!exec_pages[PC >> 8]) {
+        return 0;
+    }
+
+    for (int i = 0; i < DEBUG_POINT_MAX; i++) {
+        const DEBUG_POINT *point = &debug_points[i];
+
+        if (point->used && (point->type & DEBUG_EXEC) && point_contains(point, PC) &&
+            check_condition(&point->condition)) {
+            debug_break(i, DEBUG_EXEC, PC, 0);
+            debug_report();
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// 总线访问了被拿掉的页时调用, 已经停下来时只记第一次命中
+void debug_check_access(WORD address, BYTE type, BYTE value)
+{
+    if (debug_paused) {
+        return;
+    }
+
+    for (int i = 0; i < DEBUG_POINT_MAX; i++) {
+        const DEBUG_POINT *point = &debug_points[i];
+
+        if (point->used && (point->type & type) && point_contains(point, address) &&
+            check_condition(&point->condition)) {
+            debug_break(i, type, address, value);
+            return;
+        }
+    }
+}
+
+// 指令执行完之后调用, 观察点命中或者单步结束时停下来
+void debug_instruction_done()
+{
+    if (debug_single_step && !debug_paused) {
+        debug_break(-1, 0, PC, 0);
+    }
+    debug_single_step = 0;
+
+    if (debug_paused) {
+        debug_report();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef __DEBUGGER_HEADER__
+#define __DEBUGGER_HEADER__
+#include "common.h"
+
+/*
+* 断点和观察点: 没有设置时 cpu 按原来的方式全速执行, 不做任何检查.
+* 设置以后 cpu 逐条执行, 执行断点在指令开始前检查,
+* 观察点所在的页从总线页表里拿掉, 只有访问这些页时才走检查的慢路径, 命中后在这条指令执行完时停下来
+*/
+#define DEBUG_POINT_MAX (64)
+
+enum {
+    DEBUG_EXEC = 0x1,
+    DEBUG_READ = 0x2,
+    DEBUG_WRITE = 0x4,
+};
+
+enum {
+    DEBUG_REG_NONE = 0,
+    DEBUG_REG_A,
+    DEBUG_REG_X,
+    DEBUG_REG_Y,
+    DEBUG_REG_P,
+    DEBUG_REG_SP,
+};
+
+enum {
+    DEBUG_OP_EQ = 0,
+    DEBUG_OP_NE,
+    DEBUG_OP_LT,
+    DEBUG_OP_GT,
+};
+
+// 命中时还要满足的寄存器条件, reg 为 DEBUG_REG_NONE 时没有条件
+typedef struct
+{
+    BYTE reg;
+    BYTE op;
+    BYTE value;
+}DEBUG_CONDITION;
+
+extern BYTE debug_enabled; // 设置了断点或者观察点
+extern BYTE debug_paused;  // 停在断点上, cpu 不再执行
+
+int debug_add_point(BYTE type, WORD start, WORD end, const DEBUG_CONDITION *condition);
+int debug_add_spec(const char *spec);
+void debug_remove_point(int id);
+void debug_clear_points();
+
+void debug_continue();
+void debug_step();
+
+int debug_check_exec();
+void debug_check_access(WORD address, BYTE type, BYTE value);
+void debug_instruction_done();
+
+#endif
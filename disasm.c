@@ -14,7 +14,7 @@ void display(BYTE *data, size_t count)
 
 void parse_code()
 {
-    cpu.P = 0x24;
+    cpu_set_status(0x24);
     cpu.cycle = 7;
 
     WORD addr = 0xC000;
@@ -30,8 +30,8 @@ void parse_code()
             break;
         }
 
-        printf("%04X %02X A:%02X X:%02X Y:%02X P:%02X SP:%02X  PPU:  %d, %d CYC:%I64u\n", \
-               PC, code, cpu.A, cpu.X, cpu.Y, cpu.P, cpu.SP, ppu.ppustatus, ppu.ppuctrl, cpu.cycle);
+        printf("%04X %02X A:%02X X:%02X Y:%02X P:%02X SP:%02X  PPU:  %d, %d CYC:%" PRIu64 "\n", \
+               PC, code, cpu.A, cpu.X, cpu.Y, cpu_get_status(), cpu.SP, ppu.ppustatus, ppu.ppuctrl, cpu.cycle);
 
         code_maps[code].op_func(code);
         cpu.cycle += code_maps[code].cycle;
@@ -59,7 +59,7 @@ void print_status_flags(char *buffer, uint8_t P)
 void do_disassemble(WORD addr, BYTE opcode)
 {
     char status_flags[9] = {0}; // 用于存储状态寄存器标志位的字符串
-    print_status_flags(status_flags, cpu.P);
+    print_status_flags(status_flags, cpu_get_status());
 
     printf("%04X  ", addr);
 
@@ -74,12 +74,35 @@ void do_disassemble(WORD addr, BYTE opcode)
 
     printf("  %-4s", code_maps[opcode].op_name);
 
-    printf("    A:%02X X:%02X Y:%02X S:%02X P:%s V:%-4d   H:%-4d Fr:%d Cycle:%d\n", cpu.A, cpu.X, cpu.Y, cpu.SP, status_flags, ppu.scanline, ppu.cycle, ppu.frame_count, cpu.cycle);
+    printf("    A:%02X X:%02X Y:%02X S:%02X P:%s V:%-4d   H:%-4d Fr:%d Cycle:%" PRIu64 "\n", cpu.A, cpu.X, cpu.Y, cpu.SP, status_flags, ppu.scanline, ppu.cycle, ppu.frame_count, cpu.cycle);
+}
+
+// 把 addr 处的一条指令(code 是指令的字节) 翻译成 "LDA $0200,X" 这样的文本
+void disassemble_bytes(WORD addr, const BYTE *code, char *buffer, size_t size)
+{
+    const INS *ins = &code_maps[code[0]];
+    WORD word = code[1] | (code[2] << 8);
+
+    switch (ins->mode) {
+        case ADDR_ACC: snprintf(buffer, size, "%s A", ins->op_name); break;
+        case ADDR_IMM: snprintf(buffer, size, "%s #$%02X", ins->op_name, code[1]); break;
+        case ADDR_ZP:  snprintf(buffer, size, "%s $%02X", ins->op_name, code[1]); break;
+        case ADDR_ZPX: snprintf(buffer, size, "%s $%02X,X", ins->op_name, code[1]); break;
+        case ADDR_ZPY: snprintf(buffer, size, "%s $%02X,Y", ins->op_name, code[1]); break;
+        case ADDR_ABS: snprintf(buffer, size, "%s $%04X", ins->op_name, word); break;
+        case ADDR_ABX: snprintf(buffer, size, "%s $%04X,X", ins->op_name, word); break;
+        case ADDR_ABY: snprintf(buffer, size, "%s $%04X,Y", ins->op_name, word); break;
+        case ADDR_IND: snprintf(buffer, size, "%s ($%04X)", ins->op_name, word); break;
+        case ADDR_IZX: snprintf(buffer, size, "%s ($%02X,X)", ins->op_name, code[1]); break;
+        case ADDR_IZY: snprintf(buffer, size, "%s ($%02X),Y", ins->op_name, code[1]); break;
+        case ADDR_REL: snprintf(buffer, size, "%s $%04X", ins->op_name, (WORD)(addr + 2 + (int8_t)code[1])); break;
+        default:       snprintf(buffer, size, "%s", ins->op_name); break;
+    }
 }
 
 void disassemble()
 {
-    cpu.P = 0x24;
+    cpu_set_status(0x24);
 
     WORD addr = PC;
     while (addr) {
@@ -5,4 +5,5 @@
 void display(BYTE *data, size_t count);
 void disassemble();
 void parse_code();
+void disassemble_bytes(WORD addr, const BYTE *code, char *buffer, size_t size);
 #endif
\ No newline at end of file
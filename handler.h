@@ -1,89 +1,855 @@
+#ifndef __HANDLER_HEADER__
+#define __HANDLER_HEADER__
 #include "common.h"
+#include "memory.h"
+#include "profile.h"
 
-void push(BYTE data);
-
-void handler_ADC(WORD address);
-void handler_SBC(WORD address);
-void handler_ORA(WORD address);
-void handler_SLO(WORD address);
-void handler_ASL(WORD address);
-void handler_AND(WORD address);
-void handler_ROL(WORD address);
-void handler_EOR(WORD address);
-void handler_LSR(WORD address);
-void handler_ROR(WORD address);
-void handler_LDX(WORD address);
-void handler_LDY(WORD address);
-void handler_LDA(WORD address);
-void handler_CMP(WORD address);
-void handler_CPY(WORD address);
-void handler_DCP(WORD address);
-void handler_CPX(WORD address);
-void handler_ISC(WORD address);
-void handler_INC(WORD address);
-void handler_DEC(WORD address);
-void handler_LAX(WORD address);
-void handler_SRE(WORD address);
-void handler_RRA(WORD address);
-void handler_RLA(WORD address);
-void handler_ARR(WORD address);
-void handler_AAC(WORD address);
-void handler_BIT(WORD address);
-void handler_JSR(WORD address);
-void handler_BRK(WORD address);
-void handler_BPL(WORD address);
-void handler_BEQ(WORD address);
-void handler_BNE(WORD address);
-void handler_ASL_REG(WORD address);
-void handler_AXA(WORD address);
-void handler_CLC(WORD address);
-void handler_KIL(WORD address);
-void handler_DOP(WORD address);
-void handler_NOP(WORD address);
-void handler_PHP(WORD address);
-void handler_PLP(WORD address);
-void handler_ROL_REG_A(WORD address);
-void handler_RTI(WORD address);
-void handler_BMI(WORD address);
-void handler_TOP(WORD address);
-void handler_LSR_REG_A(WORD address);
-void handler_ASR(WORD address);
-void handler_BVC(WORD address);
-void handler_RTS(WORD address);
-void handler_PLA(WORD address);
-void handler_ROR_REG_A(WORD address);
-void handler_BVS(WORD address);
-void handler_SEI(WORD address);
-void handler_STA(WORD address);
-void handler_AAX(WORD address);
-void handler_STX(WORD address);
-void handler_TYA(WORD address);
-void handler_TXS(WORD address);
-void handler_XAS(WORD address);
-void handler_SYA(WORD address);
-void handler_SXA(WORD address);
-void handler_TAY(WORD address);
-void handler_TAX(WORD address);
-void handler_ATX(WORD address);
-void handler_BCS(WORD address);
-void handler_CLV(WORD address);
-void handler_TSX(WORD address);
-void handler_LAR(WORD address);
-void handler_INY(WORD address);
-void handler_DEX(WORD address);
-void handler_AXS(WORD address);
-void handler_CLD(WORD address);
-void handler_INX(WORD address);
-void handler_SED(WORD address);
-void handler_XAA(WORD address);
-void handler_STY(WORD address);
-void handler_DEY(WORD address);
-void handler_TXA(WORD address);
-void handler_BCC(WORD address);
-void handler_SEC(WORD address);
-void handler_PHA(WORD address);
-void handler_CLI(WORD address);
+/*
+* 每条指令的操作, 参数是寻址得到的地址. 都定义在头文件里并且强制内联, 和 cpu.c 里的寻址函数一起
+* 展开到每个操作码的执行函数里; 单循环解释器里再整个展开到对应操作码的标签下面, 不再有函数调用
+*/
+
+// N 和 Z 只记下结果, 用到的时候再判断
+ALWAYS_INLINE void set_nz(BYTE value)
+{
+    cpu.flag_n = value;
+    cpu.flag_z = value;
+}
+
+ALWAYS_INLINE void push(BYTE data)
+{
+    stack_push(data);
+}
+
+ALWAYS_INLINE BYTE pop()
+{
+    return stack_pop();
+}
+
+ALWAYS_INLINE void jump(WORD address)
+{
+    BYTE addr1 = cpu_read(address);
+    BYTE addr2 = cpu_read(address + 1);
+
+    PC = addr2 << 8 | addr1;
+}
+
+ALWAYS_INLINE WORD IRQ_vector()
+{
+    return 0xFFFE;
+}
+
+ALWAYS_INLINE void handler_ADC(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    WORD ret = cpu.A + value + cpu.flag_c;
+
+    BYTE result = ret & 0xFF;
+
+    // 两个加数符号相同而结果符号不同时溢出, 只看第 7 位
+    cpu.flag_v = (cpu.A ^ result) & ~(cpu.A ^ value);
+
+    cpu.A = result;
+    set_nz(cpu.A);
+
+    // 进位标志设置
+    cpu.flag_c = ret > 0xFF;
+}
+
+ALWAYS_INLINE void handler_SBC(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    WORD ret = cpu.A - value - (cpu.flag_c ? 0 : 1);
+
+    cpu.flag_v = (cpu.A ^ value) & (cpu.A ^ ret);
+
+    cpu.A = ret & 0xFF;
+    set_nz(cpu.A);
+
+    // 没有借位时 C = 1
+    cpu.flag_c = !(ret >> 8);
+}
+
+ALWAYS_INLINE void handler_ORA(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = cpu.A | value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_SLO(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.flag_c = value >> 7;
+
+    value <<= 1;
+
+    cpu_write(address, value);
+
+    cpu.A |= value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_ASL(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    //第七位进入进位
+    cpu.flag_c = value >> 7;
+
+    value <<= 1;
+
+    cpu_write(address, value);
+
+    set_nz(value);
+}
+
+ALWAYS_INLINE void handler_AND(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_ROL(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    BYTE carry = value >> 7;
+
+    value = (value << 1) | cpu.flag_c;
+    cpu.flag_c = carry;
+
+    cpu_write(address, value);
+
+    set_nz(value);
+}
+
+ALWAYS_INLINE void handler_EOR(WORD address)
+{
+    BYTE value = cpu_read(address);
+    cpu.A = cpu.A ^ value;
+
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_LSR(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.flag_c = value & 0x01;
+    value >>= 1;
+
+    cpu_write(address, value);
+
+    set_nz(value);
+}
+
+ALWAYS_INLINE void handler_ROR(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    BYTE carry = value & 0x01;
+
+    value = (value >> 1) | (cpu.flag_c << 7);
+    cpu.flag_c = carry;
+
+    cpu_write(address, value);
+
+    set_nz(value);
+}
+
+ALWAYS_INLINE void handler_LDX(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.X = value;
+    set_nz(cpu.X);
+}
+
+ALWAYS_INLINE void handler_LDY(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.Y = value;
+
+    set_nz(value);
+}
+
+ALWAYS_INLINE void handler_LDA(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = value;
+    set_nz(value);
+}
+
+ALWAYS_INLINE void handler_CMP(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    // 相减的结果决定 N Z, 不借位时 C = 1
+    cpu.flag_c = cpu.A >= value;
+    set_nz(cpu.A - value);
+}
+
+ALWAYS_INLINE void handler_CPY(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    // 相减的结果决定 N Z, 不借位时 C = 1
+    cpu.flag_c = cpu.Y >= value;
+    set_nz(cpu.Y - value);
+}
+
+ALWAYS_INLINE void handler_DCP(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    BYTE ret = value - 1;
+    cpu_write(address, ret);
+
+    BYTE sr = cpu.A - ret;
+    set_nz(sr);
+
+    cpu.flag_c = cpu.A >= sr;
+}
+
+ALWAYS_INLINE void handler_CPX(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    // 相减的结果决定 N Z, 不借位时 C = 1
+    cpu.flag_c = cpu.X >= value;
+    set_nz(cpu.X - value);
+}
+
+ALWAYS_INLINE void handler_ISC(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    value += 1;
+    cpu_write(address, value);
+
+    WORD ret = cpu.A - value - (cpu.flag_c ? 0 : 1);
+
+    cpu.flag_v = (cpu.A ^ value) & (cpu.A ^ ret);
+
+    cpu.A = ret & 0xFF;
+    set_nz(cpu.A);
+
+    cpu.flag_c = !(ret >> 8);
+}
+
+ALWAYS_INLINE void handler_INC(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    char ret = value + 1;
+    cpu_write(address, ret);
+
+    set_nz(ret);
+}
+
+ALWAYS_INLINE void handler_DEC(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    char ret = value - 1;
+    cpu_write(address, ret);
+
+    set_nz(ret);
+}
+
+ALWAYS_INLINE void handler_LAX(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = value;
+    cpu.X = value;
+
+    set_nz(value);
+}
+
+ALWAYS_INLINE void handler_SRE(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.flag_c = value & 0x01;
+
+    value >>= 1;
+
+    cpu_write(address, value);
+
+    cpu.A ^= value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_RRA(WORD address)
+{
+   handler_ROR(address);
+
+   handler_ADC(address);
+}
+
+ALWAYS_INLINE void handler_RLA(WORD address)
+{
+    handler_ROL(address);
+
+    handler_AND(address);
+}
+
+ALWAYS_INLINE void handler_ARR(WORD address)
+{
+    BYTE value = cpu_read(address);
+    cpu.A &= value;
+
+    // 进位标志位作为新最高位右移
+    cpu.A = (cpu.A >> 1) | (cpu.flag_c << 7);
+    set_nz(cpu.A);
+
+    // C 取第 6 位, V 取第 6 位和第 5 位的异或
+    cpu.flag_c = (cpu.A >> 6) & 0x01;
+    cpu.flag_v = (cpu.A ^ (cpu.A << 1)) << 1;
+}
+
+ALWAYS_INLINE void handler_AAC(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A &= value;
+    set_nz(cpu.A);
+
+    // 第 7 位同时进入进位
+    cpu.flag_c = cpu.A >> 7;
+}
+
+ALWAYS_INLINE void handler_BIT(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    // N V 取自内存的第 7、6 位, Z 取自和 A 相与的结果
+    cpu.flag_n = value;
+    cpu.flag_v = value << 1;
+    cpu.flag_z = cpu.A & value;
+}
+
+ALWAYS_INLINE void handler_JSR(WORD address)
+{
+    //返回地址压栈
+    WORD return_address = PC + 2; // 当前 PC 加 2，因为我们希望返回时跳过 JSR 指令
+
+    // 返回地址压栈
+    push((return_address >> 8) & 0xFF); // 高字节
+    push(return_address & 0xFF); // 低字节
+
+    BYTE addr1 = cpu_read(PC + 1);
+    BYTE addr2 = cpu_read(PC + 2);
+    WORD addr = addr2 << 8 | addr1;
+
+    if (call_profile_enabled) {
+        call_profiler_enter(addr, CALL_JSR);
+    }
+
+    PC = addr;
+}
+
+ALWAYS_INLINE void handler_BRK(WORD address)
+{
+    (void)address;
+
+    PC += 2;
+
+    BYTE addr1 = PC & 0xFF;
+    BYTE addr2 = (PC >> 8) & 0xFF;
+
+    push(addr2);
+    push(addr1);
+
+    uint8_t flags = cpu_get_status() | 0x30;
+    push(flags);
+
+    cpu.P |= 0x04;
+
+    addr1 = cpu_read(0xFFFE);
+    addr2 = cpu_read(0xFFFF);
+    PC = (addr2 << 8) | addr1;
+
+    if (call_profile_enabled) {
+        call_profiler_enter(PC, CALL_BRK);
+    }
+}
+
+ALWAYS_INLINE void handler_BPL(WORD address)
+{
+    if(cpu.flag_n & 0x80) return;
+
+    //分支如果没有跨页, 则 + 1, 否则 + 2;
+   cpu_extra_clock();
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_BEQ(WORD address)
+{
+    if(cpu.flag_z) return;
+
+   cpu_extra_clock();
+
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_BNE(WORD address)
+{
+    if(!cpu.flag_z) return;
+
+   cpu_extra_clock();
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_ASL_REG(WORD address)
+{
+    cpu.flag_c = cpu.A >> 7;
+
+    cpu.A <<= 1;
+
+    set_nz(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_AXA(WORD address)
+{
+    cpu.X &= cpu.A;
+    BYTE ret = cpu.X & 0x07;
+
+    cpu_write(address, ret);
+}
+
+ALWAYS_INLINE void handler_CLC(WORD address)
+{
+    cpu.flag_c = 0;
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_KIL(WORD address)
+{
+    (void)address;
+    cpu.is_lock = 1;
+}
+
+ALWAYS_INLINE void handler_DOP(WORD address)
+{
+    (void)address;
+}
+
+ALWAYS_INLINE void handler_NOP(WORD address)
+{
+    (void)address;
+}
+
+ALWAYS_INLINE void handler_PHP(WORD address)
+{
+    //入栈的时候需要带上BRK 标记和 额外标记
+    push(cpu_get_status() | 0x30);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_PLP(WORD address)
+{
+    BYTE value = pop();
+
+    //出栈后需要带上 brk 标记、忽略额外标记
+    cpu_set_status((value & 0xEF) | 0x20);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_ROL_REG_A(WORD address)
+{
+    BYTE carry = cpu.A >> 7;
+
+    cpu.A = (cpu.A << 1) | cpu.flag_c;
+    cpu.flag_c = carry;
+
+    set_nz(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_RTI(WORD address)
+{
+    if (call_profile_enabled) {
+        call_profiler_return();
+    }
+
+    BYTE value = pop();
+
+    cpu_set_status(value | 0x20);
+
+    BYTE addr1 = pop();
+    BYTE addr2 = pop();
+    WORD addr = (addr2 << 8 | addr1);
+
+    PC = addr;
+}
+
+ALWAYS_INLINE void handler_BMI(WORD address)
+{
+    if(!(cpu.flag_n & 0x80)) return;
+
+   cpu_extra_clock();
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_TOP(WORD address)
+{
+    (void)address;
+}
+
+ALWAYS_INLINE void handler_LSR_REG_A(WORD address)
+{
+    cpu.flag_c = cpu.A & 0x01;
+
+    cpu.A >>= 1;
+    set_nz(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_ASR(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A &= value;
+
+    cpu.flag_c = cpu.A & 0x01;
+
+    cpu.A >>= 1;
+    set_nz(cpu.A);
+
+    PC += 1;
+}
+
+ALWAYS_INLINE void handler_BVC(WORD address)
+{
+    if(cpu.flag_v & 0x80) return;
+
+   cpu_extra_clock();
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_RTS(WORD address)
+{
+    if (call_profile_enabled) {
+        call_profiler_return();
+    }
+
+    BYTE addr1 = pop();
+    BYTE addr2 = pop();
+
+    WORD addr = addr2 << 8 | addr1;
+    PC = addr + 1;
+}
+
+ALWAYS_INLINE void handler_PLA(WORD address)
+{
+    cpu.A = pop();
+    set_nz(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_ROR_REG_A(WORD address)
+{
+    BYTE carry = cpu.A & 0x01;
+
+    cpu.A = (cpu.A >> 1) | (cpu.flag_c << 7);
+    cpu.flag_c = carry;
+
+    set_nz(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_BVS(WORD address)
+{
+    if(!(cpu.flag_v & 0x80)) return;
+
+   cpu_extra_clock();
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_SEI(WORD address)
+{
+    cpu.P |= 0x04;
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_STA(WORD address)
+{
+    cpu_write(address, cpu.A);
+}
+
+ALWAYS_INLINE void handler_AAX(WORD address)
+{
+    BYTE value = cpu.X & cpu.A;
+
+    cpu_write(address, value);
+}
+
+ALWAYS_INLINE void handler_STX(WORD address)
+{
+    cpu_write(address, cpu.X);
+}
+
+ALWAYS_INLINE void handler_TYA(WORD address)
+{
+    cpu.A = cpu.Y;
+    set_nz(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_TXS(WORD address)
+{
+    cpu.SP = cpu.X;
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_XAS(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_SYA(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_SXA(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_TAY(WORD address)
+{
+    cpu.Y = cpu.A;
+    set_nz(cpu.Y);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_TAX(WORD address)
+{
+    cpu.X = cpu.A;
+    set_nz(cpu.X);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_ATX(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = value;
+    cpu.X = cpu.A;
+    set_nz(cpu.A);
+
+    PC += 1;
+}
+
+ALWAYS_INLINE void handler_BCS(WORD address)
+{
+    if(!cpu.flag_c) return;
+
+    //分支如果没有跨页, 则 + 1, 否则 + 2;
+   cpu_extra_clock();
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_CLV(WORD address)
+{
+    cpu.flag_v = 0;
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_TSX(WORD address)
+{
+    cpu.X = cpu.SP;
+    set_nz(cpu.X);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_LAR(WORD address)
+{
+    cpu.A = cpu_read(address);
+    set_nz(cpu.A);
+
+    cpu.X = cpu.SP;
+    set_nz(cpu.X);
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_INY(WORD address)
+{
+    cpu.Y += 1;
+    set_nz(cpu.Y);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_DEX(WORD address)
+{
+    char ret = cpu.X - 1;
+
+    cpu.X = ret;
+    set_nz(ret);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_AXS(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    WORD result = (cpu.A & cpu.X) - value;
+
+    cpu.X = result & 0xFF;
+
+    cpu.flag_c = result <= 0xFF;
+    set_nz(cpu.X);
+
+    PC += 1;
+}
+
+ALWAYS_INLINE void handler_CLD(WORD address)
+{
+    ++PC;
+    cpu.P &= ~0x08;
+}
+
+ALWAYS_INLINE void handler_INX(WORD address)
+{
+    cpu.X += 1;
+    set_nz(cpu.X);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_SED(WORD address)
+{
+    cpu.P |= 0x08;
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_XAA(WORD address)
+{
+    BYTE value = cpu_read(address);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+
+    cpu.A = cpu.A & value;
+    set_nz(cpu.A);
+}
+
+ALWAYS_INLINE void handler_STY(WORD address)
+{
+    cpu_write(address, cpu.Y);
+}
+
+ALWAYS_INLINE void handler_DEY(WORD address)
+{
+    char ret = cpu.Y - 1;
+
+    cpu.Y = ret;
+    set_nz(ret);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_TXA(WORD address)
+{
+    cpu.A = cpu.X;
+    set_nz(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_BCC(WORD address)
+{
+    if(cpu.flag_c) return;
+
+   cpu_extra_clock();
+    if((address >> 8) != (PC >> 8))cpu_extra_clock();
+
+    PC = address;
+}
+
+ALWAYS_INLINE void handler_SEC(WORD address)
+{
+    cpu.flag_c = 1;
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_PHA(WORD address)
+{
+    push(cpu.A);
+
+    ++PC;
+}
+
+ALWAYS_INLINE void handler_CLI(WORD address)
+{
+    cpu.P &= ~0x04;
+    ++PC;
+}
 
 void display_stack();
 
-void display_reg();
\ No newline at end of file
+void display_reg();
+
+#endif
@@ -0,0 +1,667 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include "jit.h"
+
+#ifdef CPU_JIT
+
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "CPU_JIT only supports x86-64"
+#endif
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/*
+* x86-64 动态编译: PRG-ROM 里执行次数达到 JIT_HOT_COUNT 的位置, 从这里开始向后
+* 翻译一个基本块. 块里只收录不会访问 I/O 的指令 (只读写 RAM/SRAM, 只读 PRG-ROM),
+* 遇到可能访问 I/O、写 mapper 或者间接寻址的指令就在它之前结束, 交回解释器执行.
+* 跳转、分支、子程序调用和返回作为块的最后一条指令.
+*
+* 常用的简单指令直接生成本地代码, 其余的生成对 cpu_execute_entry 的调用.
+* 块的入口和出口 PC、cycle 与解释器完全一致; 块内不会检查中断, 所以只有当块的
+* 最大周期数不超过下一个同步点时才会执行.
+*
+* RAM 里的代码不会被编译 (可能被改写). 块按起始指令在 ROM 中的物理位置记录, 而且不会
+* 跨越 8KB 窗口, 切换 bank 之后只会命中属于新 bank 的块. 块里写回的 PC 是编译时的 CPU 地址,
+* 同一段 ROM 映射在别的地址上时 (NROM-128 的 $C000 镜像, MMC1/MMC3 切换 PRG 模式) 不能直接用,
+* 要在新地址上重新编译.
+*/
+#define JIT_CODE_SIZE (4 * 1024 * 1024)
+#define JIT_MAX_BLOCKS (0x4000)
+#define JIT_MAX_BLOCK_INS (32)
+#define JIT_MAX_INS_CODE (64)
+#define JIT_HOT_COUNT (32)
+
+enum {
+    JIT_UNSAFE = 0,
+    JIT_IMPLIED,        // 隐含寻址, 包括累加器和栈操作
+    JIT_IMMEDIATE,
+    JIT_ZERO_PAGE,      // 零页以及零页变址, 只会访问 RAM
+    JIT_ABSOLUTE,
+    JIT_ABSOLUTE_X,
+    JIT_ABSOLUTE_Y,
+    JIT_RELATIVE,
+    JIT_JUMP,
+    JIT_JUMP_INDIRECT,
+    JIT_CALL,
+    JIT_RETURN,
+};
+
+#define JIT_MODE_MASK (0x0F)
+#define JIT_WRITE     (0x10) // 指令会写内存
+
+// 只收录官方指令, 非官方指令和 BRK、间接变址寻址一律交给解释器
+static const BYTE jit_ops[0x100] = {
+    // ADC
+    [0x69] = JIT_IMMEDIATE, [0x65] = JIT_ZERO_PAGE, [0x75] = JIT_ZERO_PAGE,
+    [0x6D] = JIT_ABSOLUTE, [0x7D] = JIT_ABSOLUTE_X, [0x79] = JIT_ABSOLUTE_Y,
+    // AND
+    [0x29] = JIT_IMMEDIATE, [0x25] = JIT_ZERO_PAGE, [0x35] = JIT_ZERO_PAGE,
+    [0x2D] = JIT_ABSOLUTE, [0x3D] = JIT_ABSOLUTE_X, [0x39] = JIT_ABSOLUTE_Y,
+    // ASL
+    [0x0A] = JIT_IMPLIED, [0x06] = JIT_ZERO_PAGE | JIT_WRITE, [0x16] = JIT_ZERO_PAGE | JIT_WRITE,
+    [0x0E] = JIT_ABSOLUTE | JIT_WRITE, [0x1E] = JIT_ABSOLUTE_X | JIT_WRITE,
+    // 分支
+    [0x10] = JIT_RELATIVE, [0x30] = JIT_RELATIVE, [0x50] = JIT_RELATIVE, [0x70] = JIT_RELATIVE,
+    [0x90] = JIT_RELATIVE, [0xB0] = JIT_RELATIVE, [0xD0] = JIT_RELATIVE, [0xF0] = JIT_RELATIVE,
+    // BIT
+    [0x24] = JIT_ZERO_PAGE, [0x2C] = JIT_ABSOLUTE,
+    // 标志位
+    [0x18] = JIT_IMPLIED, [0x38] = JIT_IMPLIED, [0x58] = JIT_IMPLIED, [0x78] = JIT_IMPLIED,
+    [0xB8] = JIT_IMPLIED, [0xD8] = JIT_IMPLIED, [0xF8] = JIT_IMPLIED,
+    // CMP
+    [0xC9] = JIT_IMMEDIATE, [0xC5] = JIT_ZERO_PAGE, [0xD5] = JIT_ZERO_PAGE,
+    [0xCD] = JIT_ABSOLUTE, [0xDD] = JIT_ABSOLUTE_X, [0xD9] = JIT_ABSOLUTE_Y,
+    // CPX, CPY
+    [0xE0] = JIT_IMMEDIATE, [0xE4] = JIT_ZERO_PAGE, [0xEC] = JIT_ABSOLUTE,
+    [0xC0] = JIT_IMMEDIATE, [0xC4] = JIT_ZERO_PAGE, [0xCC] = JIT_ABSOLUTE,
+    // DEC
+    [0xC6] = JIT_ZERO_PAGE | JIT_WRITE, [0xD6] = JIT_ZERO_PAGE | JIT_WRITE,
+    [0xCE] = JIT_ABSOLUTE | JIT_WRITE, [0xDE] = JIT_ABSOLUTE_X | JIT_WRITE,
+    // EOR
+    [0x49] = JIT_IMMEDIATE, [0x45] = JIT_ZERO_PAGE, [0x55] = JIT_ZERO_PAGE,
+    [0x4D] = JIT_ABSOLUTE, [0x5D] = JIT_ABSOLUTE_X, [0x59] = JIT_ABSOLUTE_Y,
+    // INC
+    [0xE6] = JIT_ZERO_PAGE | JIT_WRITE, [0xF6] = JIT_ZERO_PAGE | JIT_WRITE,
+    [0xEE] = JIT_ABSOLUTE | JIT_WRITE, [0xFE] = JIT_ABSOLUTE_X | JIT_WRITE,
+    // 寄存器加减和传送
+    [0xCA] = JIT_IMPLIED, [0x88] = JIT_IMPLIED, [0xE8] = JIT_IMPLIED, [0xC8] = JIT_IMPLIED,
+    [0xAA] = JIT_IMPLIED, [0xA8] = JIT_IMPLIED, [0xBA] = JIT_IMPLIED,
+    [0x8A] = JIT_IMPLIED, [0x9A] = JIT_IMPLIED, [0x98] = JIT_IMPLIED,
+    // JMP, JSR, RTS, RTI
+    [0x4C] = JIT_JUMP, [0x6C] = JIT_JUMP_INDIRECT, [0x20] = JIT_CALL,
+    [0x60] = JIT_RETURN, [0x40] = JIT_RETURN,
+    // LDA
+    [0xA9] = JIT_IMMEDIATE, [0xA5] = JIT_ZERO_PAGE, [0xB5] = JIT_ZERO_PAGE,
+    [0xAD] = JIT_ABSOLUTE, [0xBD] = JIT_ABSOLUTE_X, [0xB9] = JIT_ABSOLUTE_Y,
+    // LDX
+    [0xA2] = JIT_IMMEDIATE, [0xA6] = JIT_ZERO_PAGE, [0xB6] = JIT_ZERO_PAGE,
+    [0xAE] = JIT_ABSOLUTE, [0xBE] = JIT_ABSOLUTE_Y,
+    // LDY
+    [0xA0] = JIT_IMMEDIATE, [0xA4] = JIT_ZERO_PAGE, [0xB4] = JIT_ZERO_PAGE,
+    [0xAC] = JIT_ABSOLUTE, [0xBC] = JIT_ABSOLUTE_X,
+    // LSR
+    [0x4A] = JIT_IMPLIED, [0x46] = JIT_ZERO_PAGE | JIT_WRITE, [0x56] = JIT_ZERO_PAGE | JIT_WRITE,
+    [0x4E] = JIT_ABSOLUTE | JIT_WRITE, [0x5E] = JIT_ABSOLUTE_X | JIT_WRITE,
+    // NOP
+    [0xEA] = JIT_IMPLIED,
+    // ORA
+    [0x09] = JIT_IMMEDIATE, [0x05] = JIT_ZERO_PAGE, [0x15] = JIT_ZERO_PAGE,
+    [0x0D] = JIT_ABSOLUTE, [0x1D] = JIT_ABSOLUTE_X, [0x19] = JIT_ABSOLUTE_Y,
+    // 栈操作
+    [0x48] = JIT_IMPLIED, [0x08] = JIT_IMPLIED, [0x68] = JIT_IMPLIED, [0x28] = JIT_IMPLIED,
+    // ROL
+    [0x2A] = JIT_IMPLIED, [0x26] = JIT_ZERO_PAGE | JIT_WRITE, [0x36] = JIT_ZERO_PAGE | JIT_WRITE,
+    [0x2E] = JIT_ABSOLUTE | JIT_WRITE, [0x3E] = JIT_ABSOLUTE_X | JIT_WRITE,
+    // ROR
+    [0x6A] = JIT_IMPLIED, [0x66] = JIT_ZERO_PAGE | JIT_WRITE, [0x76] = JIT_ZERO_PAGE | JIT_WRITE,
+    [0x6E] = JIT_ABSOLUTE | JIT_WRITE, [0x7E] = JIT_ABSOLUTE_X | JIT_WRITE,
+    // SBC
+    [0xE9] = JIT_IMMEDIATE, [0xE5] = JIT_ZERO_PAGE, [0xF5] = JIT_ZERO_PAGE,
+    [0xED] = JIT_ABSOLUTE, [0xFD] = JIT_ABSOLUTE_X, [0xF9] = JIT_ABSOLUTE_Y,
+    // STA
+    [0x85] = JIT_ZERO_PAGE | JIT_WRITE, [0x95] = JIT_ZERO_PAGE | JIT_WRITE,
+    [0x8D] = JIT_ABSOLUTE | JIT_WRITE, [0x9D] = JIT_ABSOLUTE_X | JIT_WRITE,
+    [0x99] = JIT_ABSOLUTE_Y | JIT_WRITE,
+    // STX, STY
+    [0x86] = JIT_ZERO_PAGE | JIT_WRITE, [0x96] = JIT_ZERO_PAGE | JIT_WRITE, [0x8E] = JIT_ABSOLUTE | JIT_WRITE,
+    [0x84] = JIT_ZERO_PAGE | JIT_WRITE, [0x94] = JIT_ZERO_PAGE | JIT_WRITE, [0x8C] = JIT_ABSOLUTE | JIT_WRITE,
+};
+
+typedef struct
+{
+    void (*code)();
+    DECODED_INS *entry;
+    WORD address;    // 编译时第一条指令的 CPU 地址
+    WORD count;      // 块内的指令数
+    WORD max_cycles; // 块最多消耗的周期数
+}JIT_BLOCK;
+
+static BYTE *code_buffer = NULL;
+static BYTE *code_ptr = NULL;
+static BYTE *emit_ptr = NULL;
+
+static JIT_BLOCK blocks[JIT_MAX_BLOCKS];
+static int block_count = 0;
+
+// 标记无法编译的位置, 避免反复尝试
+static JIT_BLOCK no_block;
+
+#define CPU_FIELD(f) ((uint32_t)offsetof(_CPU, f))
+
+// x86-64 寄存器编号
+#define RAX (0)
+#define RCX (1)
+#define RDX (2)
+#define RBX (3)
+
+static inline void emit8(BYTE value)
+{
+    *emit_ptr++ = value;
+}
+
+static inline void emit16(WORD value)
+{
+    memcpy(emit_ptr, &value, sizeof(value));
+    emit_ptr += sizeof(value);
+}
+
+static inline void emit32(uint32_t value)
+{
+    memcpy(emit_ptr, &value, sizeof(value));
+    emit_ptr += sizeof(value);
+}
+
+static inline void emit64(uint64_t value)
+{
+    memcpy(emit_ptr, &value, sizeof(value));
+    emit_ptr += sizeof(value);
+}
+
+// ModRM: [rbx + disp32], rbx 固定指向 cpu
+static inline void emit_cpu_operand(BYTE reg, uint32_t offset)
+{
+    emit8(0x80 | (reg << 3) | RBX);
+    emit32(offset);
+}
+
+// mov reg8, byte [cpu + offset]
+static inline void emit_load8(BYTE reg, uint32_t offset)
+{
+    emit8(0x8A);
+    emit_cpu_operand(reg, offset);
+}
+
+// mov byte [cpu + offset], reg8
+static inline void emit_store8(BYTE reg, uint32_t offset)
+{
+    emit8(0x88);
+    emit_cpu_operand(reg, offset);
+}
+
+// and/or byte [cpu + offset], imm8
+static inline void emit_and_mem8(uint32_t offset, BYTE value)
+{
+    emit8(0x80);
+    emit_cpu_operand(4, offset);
+    emit8(value);
+}
+
+static inline void emit_or_mem8(uint32_t offset, BYTE value)
+{
+    emit8(0x80);
+    emit_cpu_operand(1, offset);
+    emit8(value);
+}
+
+static inline void emit_set_pc(WORD address)
+{
+    emit8(0x66);
+    emit8(0xC7);
+    emit_cpu_operand(0, CPU_FIELD(IP));
+    emit16(address);
+}
+
+static inline void emit_add_cycles(uint32_t cycles)
+{
+    if (!cycles) {
+        return;
+    }
+
+    // add qword [cpu.cycle], imm32
+    emit8(0x48);
+    emit8(0x81);
+    emit_cpu_operand(0, CPU_FIELD(cycle));
+    emit32(cycles);
+}
+
+// mov byte [cpu + offset], imm8
+static inline void emit_store_imm8(uint32_t offset, BYTE value)
+{
+    emit8(0xC6);
+    emit_cpu_operand(0, offset);
+    emit8(value);
+}
+
+// N、Z 标志延迟计算, 只需要把 al 记下来
+static inline void emit_set_nz()
+{
+    emit_store8(RAX, CPU_FIELD(flag_n));
+    emit_store8(RAX, CPU_FIELD(flag_z));
+}
+
+// 把 al 写入寄存器并设置 N、Z
+static inline void emit_store_nz(uint32_t offset)
+{
+    emit_store8(RAX, offset);
+    emit_set_nz();
+}
+
+static inline void emit_prologue()
+{
+    emit8(0x53);                                  // push rbx
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(0x20); // sub rsp, 32
+    emit8(0x48); emit8(0xBB); emit64((uint64_t)(uintptr_t)&cpu); // mov rbx, &cpu
+}
+
+static inline void emit_epilogue()
+{
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(0x20); // add rsp, 32
+    emit8(0x5B);                                  // pop rbx
+    emit8(0xC3);                                  // ret
+}
+
+static inline void emit_call_entry(const DECODED_INS *entry)
+{
+#ifdef _WIN32
+    emit8(0x48); emit8(0xB9);                     // mov rcx, entry
+#else
+    emit8(0x48); emit8(0xBF);                     // mov rdi, entry
+#endif
+    emit64((uint64_t)(uintptr_t)entry);
+    emit8(0x48); emit8(0xB8);                     // mov rax, cpu_execute_entry
+    emit64((uint64_t)(uintptr_t)cpu_execute_entry);
+    emit8(0xFF); emit8(0xD0);                     // call rax
+}
+
+// 直接翻译成本地代码的指令, 不支持的返回 0
+static int emit_native(const DECODED_INS *entry)
+{
+    BYTE imm = entry->operand & 0xFF;
+    uint32_t zero_page = CPU_FIELD(ram) + imm;
+
+    switch (entry->opcode) {
+        // LDA/LDX/LDY 立即数
+        case 0xA9: emit8(0xB0); emit8(imm); emit_store_nz(CPU_FIELD(A)); return 1;
+        case 0xA2: emit8(0xB0); emit8(imm); emit_store_nz(CPU_FIELD(X)); return 1;
+        case 0xA0: emit8(0xB0); emit8(imm); emit_store_nz(CPU_FIELD(Y)); return 1;
+
+        // AND/ORA/EOR 立即数
+        case 0x29: emit_load8(RAX, CPU_FIELD(A)); emit8(0x24); emit8(imm); emit_store_nz(CPU_FIELD(A)); return 1;
+        case 0x09: emit_load8(RAX, CPU_FIELD(A)); emit8(0x0C); emit8(imm); emit_store_nz(CPU_FIELD(A)); return 1;
+        case 0x49: emit_load8(RAX, CPU_FIELD(A)); emit8(0x34); emit8(imm); emit_store_nz(CPU_FIELD(A)); return 1;
+
+        // 零页读写
+        case 0xA5: emit_load8(RAX, zero_page); emit_store_nz(CPU_FIELD(A)); return 1;
+        case 0xA6: emit_load8(RAX, zero_page); emit_store_nz(CPU_FIELD(X)); return 1;
+        case 0xA4: emit_load8(RAX, zero_page); emit_store_nz(CPU_FIELD(Y)); return 1;
+        case 0x85: emit_load8(RAX, CPU_FIELD(A)); emit_store8(RAX, zero_page); return 1;
+        case 0x86: emit_load8(RAX, CPU_FIELD(X)); emit_store8(RAX, zero_page); return 1;
+        case 0x84: emit_load8(RAX, CPU_FIELD(Y)); emit_store8(RAX, zero_page); return 1;
+
+        // 寄存器传送
+        case 0xAA: emit_load8(RAX, CPU_FIELD(A)); emit_store_nz(CPU_FIELD(X)); return 1;
+        case 0xA8: emit_load8(RAX, CPU_FIELD(A)); emit_store_nz(CPU_FIELD(Y)); return 1;
+        case 0x8A: emit_load8(RAX, CPU_FIELD(X)); emit_store_nz(CPU_FIELD(A)); return 1;
+        case 0x98: emit_load8(RAX, CPU_FIELD(Y)); emit_store_nz(CPU_FIELD(A)); return 1;
+        case 0xBA: emit_load8(RAX, CPU_FIELD(SP)); emit_store_nz(CPU_FIELD(X)); return 1;
+        case 0x9A: emit_load8(RAX, CPU_FIELD(X)); emit_store8(RAX, CPU_FIELD(SP)); return 1;
+
+        // 寄存器加减, inc al: FE C0, dec al: FE C8
+        case 0xE8: emit_load8(RAX, CPU_FIELD(X)); emit8(0xFE); emit8(0xC0); emit_store_nz(CPU_FIELD(X)); return 1;
+        case 0xC8: emit_load8(RAX, CPU_FIELD(Y)); emit8(0xFE); emit8(0xC0); emit_store_nz(CPU_FIELD(Y)); return 1;
+        case 0xCA: emit_load8(RAX, CPU_FIELD(X)); emit8(0xFE); emit8(0xC8); emit_store_nz(CPU_FIELD(X)); return 1;
+        case 0x88: emit_load8(RAX, CPU_FIELD(Y)); emit8(0xFE); emit8(0xC8); emit_store_nz(CPU_FIELD(Y)); return 1;
+
+        // 标志位
+        case 0x18: emit_store_imm8(CPU_FIELD(flag_c), 0); return 1;
+        case 0x38: emit_store_imm8(CPU_FIELD(flag_c), 1); return 1;
+        case 0x58: emit_and_mem8(CPU_FIELD(P), (BYTE)~0x04); return 1;
+        case 0x78: emit_or_mem8(CPU_FIELD(P), 0x04); return 1;
+        case 0xD8: emit_and_mem8(CPU_FIELD(P), (BYTE)~0x08); return 1;
+        case 0xF8: emit_or_mem8(CPU_FIELD(P), 0x08); return 1;
+        case 0xB8: emit_store_imm8(CPU_FIELD(flag_v), 0); return 1;
+
+        case 0xEA: return 1;
+    }
+
+    return 0;
+}
+
+// 分支指令作为块的结尾: 不跳转 2 个周期, 跳转时加 1 个周期, 跨页再加 1 个
+static void emit_branch(const DECODED_INS *entry, WORD next, uint32_t pending_cycles)
+{
+    // 操作码的高两位依次是 N V C Z
+    static const uint32_t branch_field[4] = {
+        CPU_FIELD(flag_n), CPU_FIELD(flag_v), CPU_FIELD(flag_c), CPU_FIELD(flag_z)
+    };
+    static const BYTE branch_mask[4] = { 0x80, 0x80, 0x01, 0xFF };
+
+    WORD target = next + (int8_t)(entry->operand & 0xFF);
+    BYTE flag = entry->opcode >> 6;
+
+    // 操作码第 5 位为 1 的分支在标志位为 1 时跳转, flag_z 为 0 才表示 Z = 1
+    BYTE jump_if_set = entry->opcode & 0x20;
+    if (flag == 3) {
+        jump_if_set = !jump_if_set;
+    }
+
+    emit_add_cycles(pending_cycles + entry->cycle);
+
+    // test byte [cpu + field], mask
+    emit8(0xF6);
+    emit_cpu_operand(0, branch_field[flag]);
+    emit8(branch_mask[flag]);
+
+    // 不满足跳转条件时跳到 not_taken
+    emit8(jump_if_set ? 0x74 : 0x75);
+    BYTE *rel = emit_ptr;
+    emit8(0);
+
+    emit_set_pc(target);
+    emit_add_cycles(1 + ((target >> 8) != (next >> 8)));
+    emit_epilogue();
+
+    *rel = (BYTE)(emit_ptr - rel - 1);
+
+    emit_set_pc(next);
+    emit_epilogue();
+}
+
+static inline int is_safe_address(WORD address, BYTE write)
+{
+    // RAM 和 SRAM 直接映射, 读写都不会产生副作用
+    if (address < 0x2000 || (address >= 0x6000 && address < 0x8000)) {
+        return 1;
+    }
+
+    // PRG-ROM 只读, 写入会触发 mapper
+    return !write && address >= 0x8000;
+}
+
+static inline int is_safe_range(WORD address, int count, BYTE write)
+{
+    for (int i = 0; i < count; i++) {
+        if (!is_safe_address(address + i, write)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// 指令的访存地址是否在编译期就能确定不会碰到 I/O
+static int is_safe_instruction(BYTE info, WORD operand)
+{
+    BYTE write = info & JIT_WRITE;
+
+    switch (info & JIT_MODE_MASK) {
+        case JIT_ABSOLUTE:
+            return is_safe_range(operand, 1, write);
+        case JIT_ABSOLUTE_X:
+        case JIT_ABSOLUTE_Y:
+            return is_safe_range(operand, 0x100, write);
+        case JIT_JUMP_INDIRECT:
+            return is_safe_address(operand, 0) && is_safe_address((operand & 0xFF00) | ((operand + 1) & 0xFF), 0);
+        case JIT_UNSAFE:
+            return 0;
+    }
+
+    return 1;
+}
+
+static inline int instruction_length(BYTE mode)
+{
+    switch (mode) {
+        case JIT_IMPLIED:
+        case JIT_RETURN:
+            return 1;
+        case JIT_IMMEDIATE:
+        case JIT_ZERO_PAGE:
+        case JIT_RELATIVE:
+            return 2;
+    }
+
+    return 3;
+}
+
+static void *alloc_code_buffer()
+{
+#ifdef _WIN32
+    return VirtualAlloc(NULL, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    void *buffer = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return buffer == MAP_FAILED ? NULL : buffer;
+#endif
+}
+
+// 丢弃所有已经编译的块
+static void jit_flush()
+{
+    for (int i = 0; i < block_count; i++) {
+        blocks[i].entry->block = NULL;
+        blocks[i].entry->hits = 0;
+    }
+
+    block_count = 0;
+    code_ptr = code_buffer;
+}
+
+static JIT_BLOCK *compile_block(DECODED_INS *first, WORD address)
+{
+    if (block_count == JIT_MAX_BLOCKS ||
+        code_ptr + JIT_MAX_BLOCK_INS * JIT_MAX_INS_CODE > code_buffer + JIT_CODE_SIZE) {
+        jit_flush();
+    }
+
+    JIT_BLOCK *block = &blocks[block_count];
+    WORD pc = address;
+    uint32_t pending_cycles = 0;
+    int max_cycles = 0;
+    int count = 0;
+    int pc_synced = 1;
+    int ended = 0;
+
+    emit_ptr = code_ptr;
+    emit_prologue();
+
+    while (count < JIT_MAX_BLOCK_INS && (pc >> 13) == (address >> 13)) {
+        DECODED_INS *entry = cpu_decode(pc);
+        if (!entry) {
+            break;
+        }
+
+        BYTE info = jit_ops[entry->opcode];
+        BYTE mode = info & JIT_MODE_MASK;
+        if (!is_safe_instruction(info, entry->operand)) {
+            break;
+        }
+
+        WORD next = pc + instruction_length(mode);
+
+        // 空转循环末尾的跳转留给解释器, 由它检测并跳过整圈
+        if (mode == JIT_RELATIVE && cpu_is_idle_loop(next + (int8_t)(entry->operand & 0xFF), pc)) {
+            break;
+        }
+
+        if (mode == JIT_JUMP && cpu_is_idle_loop(entry->operand, pc)) {
+            break;
+        }
+
+        count++;
+
+        if (mode == JIT_RELATIVE) {
+            emit_branch(entry, next, pending_cycles);
+            max_cycles += entry->cycle + 2;
+            ended = 1;
+            break;
+        }
+
+        if (mode == JIT_JUMP) {
+            emit_add_cycles(pending_cycles + entry->cycle);
+            emit_set_pc(entry->operand);
+            emit_epilogue();
+            max_cycles += entry->cycle;
+            ended = 1;
+            break;
+        }
+
+        if (emit_native(entry)) {
+            pending_cycles += entry->cycle;
+            max_cycles += entry->cycle;
+            pc_synced = 0;
+        } else {
+            // 调用解释器之前先把周期和 PC 写回去
+            emit_add_cycles(pending_cycles);
+            pending_cycles = 0;
+
+            if (!pc_synced) {
+                emit_set_pc(pc);
+            }
+
+            emit_call_entry(entry);
+            max_cycles += entry->cycle + 2;
+            pc_synced = 1;
+
+            if (mode == JIT_JUMP_INDIRECT || mode == JIT_CALL || mode == JIT_RETURN) {
+                emit_epilogue();
+                ended = 1;
+                break;
+            }
+        }
+
+        pc = next;
+    }
+
+    if (!count) {
+        return &no_block;
+    }
+
+    // 没有以跳转结束的块, 出口是下一条指令
+    if (!ended) {
+        emit_add_cycles(pending_cycles);
+
+        if (!pc_synced) {
+            emit_set_pc(pc);
+        }
+
+        emit_epilogue();
+    }
+
+    block->code = (void (*)())code_ptr;
+    block->entry = first;
+    block->address = address;
+    block->count = count;
+    block->max_cycles = max_cycles;
+
+    code_ptr = emit_ptr;
+    block_count++;
+
+    return block;
+}
+
+#ifdef CPU_JIT_VERIFY
+
+/*
+* 对比模式: 先执行本地代码, 保存结果, 再恢复现场用解释器执行同样数量的指令,
+* 两边的 CPU 状态、RAM 和 SRAM 必须完全一致
+*/
+static void verify_block(JIT_BLOCK *block)
+{
+    static _CPU cpu_before, cpu_after;
+    static BYTE sram_before[SRAM_SIZE], sram_after[SRAM_SIZE];
+
+    memcpy(&cpu_before, &cpu, sizeof(_CPU));
+    memcpy(sram_before, sram, SRAM_SIZE);
+
+    block->code();
+
+    memcpy(&cpu_after, &cpu, sizeof(_CPU));
+    memcpy(sram_after, sram, SRAM_SIZE);
+
+    memcpy(&cpu, &cpu_before, sizeof(_CPU));
+    memcpy(sram, sram_before, SRAM_SIZE);
+
+    for (int i = 0; i < block->count; i++) {
+        cpu_interpret_instruction();
+    }
+
+    if (memcmp(&cpu_after, &cpu, sizeof(_CPU)) || memcmp(sram_after, sram, SRAM_SIZE) ||
+        cpu.cycle - cpu_before.cycle > block->max_cycles) {
+        fprintf(stderr, "jit mismatch, block %04X (%d instructions)\n", cpu_before.IP, block->count);
+        fprintf(stderr, "  jit:    PC:%04X A:%02X X:%02X Y:%02X P:%02X NVZC:%02X %02X %02X %02X SP:%02X CYC:%" PRIu64 "\n",
+            cpu_after.IP, cpu_after.A, cpu_after.X, cpu_after.Y, cpu_after.P,
+            cpu_after.flag_n, cpu_after.flag_v, cpu_after.flag_z, cpu_after.flag_c, cpu_after.SP, cpu_after.cycle);
+        fprintf(stderr, "  interp: PC:%04X A:%02X X:%02X Y:%02X P:%02X NVZC:%02X %02X %02X %02X SP:%02X CYC:%" PRIu64 "\n",
+            cpu.IP, cpu.A, cpu.X, cpu.Y, cpu.P, cpu.flag_n, cpu.flag_v, cpu.flag_z, cpu.flag_c, cpu.SP, cpu.cycle);
+        exit(-1);
+    }
+}
+
+#endif
+
+void jit_reset()
+{
+    if (!code_buffer) {
+        code_buffer = alloc_code_buffer();
+        if (!code_buffer) {
+            fprintf(stderr, "alloc jit code buffer failed!\n");
+            exit(-1);
+        }
+    }
+
+    // 预解码表已经重新分配, 旧的表项不需要清理
+    block_count = 0;
+    code_ptr = code_buffer;
+}
+
+int jit_execute(DECODED_INS *entry, uint64_t limit_cycle)
+{
+    JIT_BLOCK *block = entry->block;
+
+    // 同一段 ROM 映射到了别的地址上, 旧块里的 PC 不对, 在这里也执行到 JIT_HOT_COUNT 次以后重新编译
+    if (block && block != &no_block && block->address != PC) {
+        block = NULL;
+    }
+
+    if (!block) {
+        if (++entry->hits < JIT_HOT_COUNT) {
+            return 0;
+        }
+
+        entry->hits = 0;
+        block = compile_block(entry, PC);
+        entry->block = block;
+    }
+
+    if (block == &no_block || cpu.cycle + block->max_cycles >= limit_cycle) {
+        return 0;
+    }
+
+#ifdef CPU_JIT_VERIFY
+    verify_block(block);
+#else
+    block->code();
+#endif
+
+    return 1;
+}
+
+#endif
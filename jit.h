@@ -0,0 +1,13 @@
+#ifndef __JIT_HEADER__
+#define __JIT_HEADER__
+#include "common.h"
+#include "cpu.h"
+
+#ifdef CPU_JIT
+
+void jit_reset();
+int jit_execute(DECODED_INS *entry, uint64_t limit_cycle);
+
+#endif
+
+#endif
@@ -3,6 +3,10 @@
 #include "memory.h"
 #include "ppu.h"
 #include "mapper.h"
+#include "profile.h"
+#include "trace.h"
+#include "debugger.h"
+#include "cdl.h"
 
 #define NTSC_CPU_CYCLES_PER_FRAME 29781 // 精确值，以避免窗口卡顿
 #define PAL_CPU_CYCLES_PER_FRAME 33248 // 精确值，以避免窗口卡顿
@@ -11,8 +15,19 @@
 
 #define FRAME_DURATION 1000 / 60 // 60 FPS
 
+#define PROFILE_FILE "profile.txt"
+#define CALL_PROFILE_FILE "call_profile.txt"
+#define TRACE_FILE "trace.bin"
+
+static SDL_bool profile_enabled = SDL_FALSE;
+static SDL_bool cdl_requested = SDL_FALSE;
+static SDL_atomic_t profile_dump_requested; // F8 设置, 模拟线程在两帧之间写出
+
 void reload_rom(const char *filename)
 {
+    // 先把上一个 rom 的记录写到它的 .cdl 文件
+    cdl_stop();
+
     fc_release();
 
     set_current_rom(load_rom(filename));
@@ -21,6 +36,10 @@ void reload_rom(const char *filename)
     mapper_reset();
     cpu_reset();
     ppu_reset();
+
+    if (cdl_requested) {
+        cdl_start(filename);
+    }
 }
 
 char *get_file_name(char *filename, const char *filepath)
@@ -100,6 +119,20 @@ int process_events(SDL_Renderer* renderer)
                 exit(0);
                 break;
             case SDL_KEYDOWN:
+                // F8 把当前的采样结果写到文件, 模拟线程还在运行, 交给它在一帧结束时写
+                if (profile_enabled && event.key.keysym.sym == SDLK_F8) {
+                    SDL_AtomicSet(&profile_dump_requested, 1);
+                    break;
+                }
+                // 停在断点上时 F5 继续运行, F6 单步执行一条指令
+                if (debug_paused && event.key.keysym.sym == SDLK_F5) {
+                    debug_continue();
+                    break;
+                }
+                if (debug_paused && event.key.keysym.sym == SDLK_F6) {
+                    debug_step();
+                    break;
+                }
                 handle_key(event.key.keysym.sym, event.key.keysym.scancode, 1);
                 break;
             case SDL_KEYUP:
@@ -136,16 +169,26 @@ int main_loop(void *arg)
     SDL_Texture *texture = SDL_CreateTexture(screen->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
     set_SDLdevice(screen->renderer, texture);
 
-    uint32_t total_cpu_cycles = 1;
+    uint64_t total_cpu_cycles = 1;
 
     for (;;) {
 
-        if (!is_load_rom()) {
+        // 处理 F8 的请求: 两帧之间 cpu 停着, 采样表不会被改写
+        if (SDL_AtomicCAS(&profile_dump_requested, 1, 0)) {
+            profiler_dump_file(PROFILE_FILE);
+        }
+
+        if (!is_load_rom() || debug_paused) {
             SDL_Delay(1);
             continue;
         }
 
-        total_cpu_cycles += step_cpu();
+        // 每次跑完一整帧再回来, 检查 rom 的状态
+        total_cpu_cycles += cpu_run_frame();
+
+        if (call_profile_enabled) {
+            call_profiler_frame();
+        }
     }
 
     // 清理SDL
@@ -236,12 +279,16 @@ void fc_init(const char *filename)
     set_current_rom(load_rom(filename));
     bus_init_page_cache();
 
-    //FIXME: 由于链接顺序的问题, 只能放在前面, what the fuck!
+    // 要先选好 mapper: cpu_init 通过它读复位向量, ppu_init 通过它预解码 CHR 图块
     mapper_init();
 
     apu_init();
     cpu_init();
     ppu_init();
+
+    if (cdl_requested) {
+        cdl_start(filename);
+    }
 }
 
 void set_init_state()
@@ -252,10 +299,107 @@ void set_init_state()
     strcpy(window_title,  "NES Emulator");
 }
 
+static void dump_profile()
+{
+    profiler_dump_file(PROFILE_FILE);
+}
+
+// 设置了环境变量 FC_PROFILE(采样间隔的 cpu 周期数) 时打开采样分析器, 退出时写到 profile.txt
+static void init_profiler()
+{
+    const char *period = getenv("FC_PROFILE");
+    if (!period) {
+        return;
+    }
+
+    profiler_start(strtoul(period, NULL, 10));
+    profile_enabled = SDL_TRUE;
+    atexit(dump_profile);
+}
+
+static FILE *call_profile_fp = NULL;
+
+static void dump_call_profile()
+{
+    call_profiler_stop();
+    call_profiler_dump(call_profile_fp);
+    fclose(call_profile_fp);
+}
+
+// 设置了环境变量 FC_CALL_PROFILE 时打开子程序分析器, 每帧的调用树和退出时累计的调用树都写到 call_profile.txt
+static void init_call_profiler()
+{
+    if (!getenv("FC_CALL_PROFILE")) {
+        return;
+    }
+
+    call_profile_fp = fopen(CALL_PROFILE_FILE, "w");
+    if (!call_profile_fp) {
+        fprintf(stderr, "error cannot open file: %s!\n", CALL_PROFILE_FILE);
+        return;
+    }
+
+    call_profiler_start(call_profile_fp);
+    atexit(dump_call_profile);
+}
+
+// 设置了环境变量 FC_TRACE 时把每条指令记录到 trace.bin, 用 tracedump 还原成文本
+static void init_trace()
+{
+    if (!getenv("FC_TRACE") || trace_start(TRACE_FILE)) {
+        return;
+    }
+
+    atexit(trace_stop);
+}
+
+// 环境变量 FC_DEBUG 里是用逗号分开的断点, 格式见 debug_add_spec
+static void init_debugger()
+{
+    const char *specs = getenv("FC_DEBUG");
+    if (!specs) {
+        return;
+    }
+
+    char spec[64];
+    while (*specs) {
+        size_t length = strcspn(specs, ",");
+        if (length && length < sizeof(spec)) {
+            memcpy(spec, specs, length);
+            spec[length] = '\0';
+
+            if (debug_add_spec(spec) < 0) {
+                fprintf(stderr, "invalid breakpoint: %s\n", spec);
+            }
+        }
+
+        specs += length;
+        if (*specs) {
+            specs++;
+        }
+    }
+}
+
+// 设置了环境变量 FC_CDL 时记录 rom 里哪些字节是代码、哪些是数据, 退出或者换 rom 时和 rom 旁边的 .cdl 文件合并
+static void init_cdl()
+{
+    if (!getenv("FC_CDL")) {
+        return;
+    }
+
+    cdl_requested = SDL_TRUE;
+    atexit(cdl_stop);
+}
+
 #undef main
 int main(int argc, char *argv[])
 {
     set_init_state();
+    init_profiler();
+    init_call_profiler();
+    init_trace();
+    init_debugger();
+    init_cdl();
 
     start();
 
@@ -1,5 +1,7 @@
 #include "mapper.h"
 #include "ppu.h"
+#include "cpu.h"
+#include "memory.h"
 
 MAPPER mappers[0x100];
 
@@ -10,8 +12,8 @@ static inline MAPPER *get_mapper_for_current_rom()
     BYTE number = get_current_rom()->header->mapper_number;
     MAPPER *mapper = &mappers[number];
 
-    if (!mapper->prg_rom_read || !mapper->prg_rom_write ||
-        !mapper->chr_rom_read || !mapper->chr_rom_write ||
+    if (!mapper->prg_rom_read || !mapper->prg_rom_write || !mapper->prg_rom_offset ||
+        !mapper->chr_rom_read || !mapper->chr_rom_write || !mapper->chr_rom_offset ||
         !mapper->irq_scanline || !mapper->mapper_reset) {
         fprintf(stderr, "ERROR, mapper: %d is not support!\n", number);
         exit(-1);
@@ -41,6 +43,8 @@ void mapper_init()
 
     active_mapper = get_mapper_for_current_rom();
     active_mapper->mapper_reset();
+    cpu_invalidate_decode_cache();
+    bus_invalidate_prg_pages();
 }
 
 BYTE prg_rom_read(WORD address)
@@ -52,6 +56,13 @@ void prg_rom_write(WORD address, BYTE data)
 {
     get_active_mapper()->prg_rom_write(address, data);
     ppu_invalidate_render_cache();
+    cpu_invalidate_decode_cache();
+    bus_invalidate_prg_pages();
+}
+
+size_t prg_rom_offset(WORD address)
+{
+    return get_active_mapper()->prg_rom_offset(address);
 }
 
 BYTE chr_rom_read(WORD address)
@@ -64,10 +75,17 @@ void chr_rom_write(WORD address, BYTE data)
     get_active_mapper()->chr_rom_write(address, data);
 }
 
+size_t chr_rom_offset(WORD address)
+{
+    return get_active_mapper()->chr_rom_offset(address);
+}
+
 void mapper_reset()
 {
     active_mapper = get_mapper_for_current_rom();
     active_mapper->mapper_reset();
+    cpu_invalidate_decode_cache();
+    bus_invalidate_prg_pages();
 }
 
 void irq_scanline()
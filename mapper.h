@@ -14,8 +14,10 @@ extern MAPPER mappers[0x100];
     mappers[n].name = s; \
     mappers[n].prg_rom_read = prg_rom_read##n; \
     mappers[n].prg_rom_write = prg_rom_write##n; \
+    mappers[n].prg_rom_offset = prg_rom_offset##n; \
     mappers[n].chr_rom_read = chr_rom_read##n; \
     mappers[n].chr_rom_write = chr_rom_write##n; \
+    mappers[n].chr_rom_offset = chr_rom_offset##n; \
     mappers[n].irq_scanline = irq_scanline##n; \
     mappers[n].mapper_reset = mapper_reset##n; \
 
@@ -13,6 +13,11 @@ BYTE prg_rom_read0(WORD address)
     return get_current_rom()->prg_rom[_address];
 }
 
+size_t prg_rom_offset0(WORD address)
+{
+    return get_address(address);
+}
+
 void prg_rom_write0(WORD address, BYTE data)
 {
     WORD _address = get_address(address);
@@ -35,6 +40,12 @@ void chr_rom_write0(WORD address, BYTE data)
     }
 }
 
+// PPU 地址对应的 CHR-ROM 偏移
+size_t chr_rom_offset0(WORD address)
+{
+    return address;
+}
+
 void irq_scanline0()
 {
 
@@ -81,6 +81,11 @@ BYTE prg_rom_read1(WORD address)
     return get_current_rom()->prg_rom[_address];
 }
 
+size_t prg_rom_offset1(WORD address)
+{
+    return get_prg_address(address);
+}
+
 void prg_rom_write1(WORD address, BYTE data)
 {
     /*写入任意bit7 是1 的值, 都会清空shift register*/
@@ -135,6 +140,11 @@ void chr_rom_write1(WORD address, BYTE data)
     }
 }
 
+size_t chr_rom_offset1(WORD address)
+{
+    return get_chr_address(address);
+}
+
 void irq_scanline1()
 {
     ;
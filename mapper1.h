@@ -15,8 +15,10 @@ typedef struct {
 
 BYTE prg_rom_read1(WORD address);
 void prg_rom_write1(WORD address, BYTE data);
+size_t prg_rom_offset1(WORD address);
 BYTE chr_rom_read1(WORD address);
 void chr_rom_write1(WORD address, BYTE data);
+size_t chr_rom_offset1(WORD address);
 void irq_scanline1();
 void mapper_reset1();
 
@@ -21,6 +21,11 @@ BYTE prg_rom_read2(WORD address)
     return data;
 }
 
+size_t prg_rom_offset2(WORD address)
+{
+    return get_address(address);
+}
+
 void prg_rom_write2(WORD address, BYTE data)
 {
     (void)address;
@@ -44,6 +49,11 @@ void chr_rom_write2(WORD address, BYTE data)
     }
 }
 
+size_t chr_rom_offset2(WORD address)
+{
+    return address;
+}
+
 void irq_scanline2()
 {
     ;
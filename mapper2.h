@@ -4,8 +4,10 @@
 
 BYTE prg_rom_read2(WORD address);
 void prg_rom_write2(WORD address, BYTE data);
+size_t prg_rom_offset2(WORD address);
 BYTE chr_rom_read2(WORD address);
 void chr_rom_write2(WORD address, BYTE data);
+size_t chr_rom_offset2(WORD address);
 void irq_scanline2();
 void mapper_reset2();
 
@@ -14,6 +14,11 @@ BYTE prg_rom_read3(WORD address)
     return get_current_rom()->prg_rom[_address];
 }
 
+size_t prg_rom_offset3(WORD address)
+{
+    return get_address(address);
+}
+
 void prg_rom_write3(WORD address, BYTE data)
 {
     bank_number = data & 0x3;
@@ -41,6 +46,11 @@ void chr_rom_write3(WORD address, BYTE data)
     }
 }
 
+size_t chr_rom_offset3(WORD address)
+{
+    return get_chr_address(address);
+}
+
 void irq_scanline3()
 {
     ;
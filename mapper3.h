@@ -4,8 +4,10 @@
 
 BYTE prg_rom_read3(WORD address);
 void prg_rom_write3(WORD address, BYTE data);
+size_t prg_rom_offset3(WORD address);
 BYTE chr_rom_read3(WORD address);
 void chr_rom_write3(WORD address, BYTE data);
+size_t chr_rom_offset3(WORD address);
 void irq_scanline3();
 void mapper_reset3();
 
@@ -49,6 +49,11 @@ BYTE prg_rom_read4(WORD address)
     return get_current_rom()->prg_rom[_address];
 }
 
+size_t prg_rom_offset4(WORD address)
+{
+    return get_prg_address(address);
+}
+
 void prg_rom_write4(WORD address, BYTE data)
 {
 
@@ -185,6 +190,11 @@ void chr_rom_write4(WORD address, BYTE data)
     }
 }
 
+size_t chr_rom_offset4(WORD address)
+{
+    return get_chr_address(address);
+}
+
 void irq_scanline4()
 {
     BYTE need_irq = 0;
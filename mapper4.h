@@ -23,8 +23,10 @@ typedef struct {
 
 BYTE prg_rom_read4(WORD address);
 void prg_rom_write4(WORD address, BYTE data);
+size_t prg_rom_offset4(WORD address);
 BYTE chr_rom_read4(WORD address);
 void chr_rom_write4(WORD address, BYTE data);
+size_t chr_rom_offset4(WORD address);
 void irq_scanline4();
 void mapper_reset4();
 
@@ -2,10 +2,18 @@
 #include "cpu.h"
 #include "ppu.h"
 #include "controller.h"
+#include "debugger.h"
+#include "cdl.h"
 
 static BYTE *read_page_ptr[0x100];
 static BYTE *write_page_ptr[0x100];
 static BYTE page_cache_ready = 0;
+static BYTE prg_pages_ready = 0;
+
+// 有观察点的页, 这些页在页表里是空的, 访问时先检查观察点
+static BYTE watch_read_pages[0x100];
+static BYTE watch_write_pages[0x100];
+BYTE bus_watch_low = 0;
 
 static inline BYTE read_controller_port(WORD address)
 {
@@ -22,8 +30,40 @@ static inline BYTE read_controller_port(WORD address)
     return data;
 }
 
+/*
+* $8000-$FFFF 的读页表按 mapper 当前的 bank 映射填写, 读 PRG-ROM 只需要一次指针访问.
+* mapper 切换 bank 时调用 bus_invalidate_prg_pages, 下一次读取时再重新填写;
+* 映射到 ROM 之外的页不填, 仍然交给 mapper 处理. 写入始终走 mapper.
+* 代码/数据记录打开时也不填, 数据读取在慢路径里记录.
+*/
+static void update_prg_pages()
+{
+    ROM *rom = get_current_rom();
+    size_t prg_size = rom->header->prg_rom_count * PRG_ROM_PAGE_SIZE;
+
+    for (int page = 0x80; page <= 0xFF; ++page) {
+        size_t offset = prg_rom_offset(page << 8);
+        BYTE direct = offset + 0x100 <= prg_size && !watch_read_pages[page] && !cdl_enabled;
+
+        read_page_ptr[page] = direct ? rom->prg_rom + offset : NULL;
+    }
+
+    prg_pages_ready = 1;
+}
+
+void bus_invalidate_prg_pages()
+{
+    memset(read_page_ptr + 0x80, 0, 0x80 * sizeof(read_page_ptr[0]));
+    prg_pages_ready = 0;
+}
+
 static inline BYTE slow_bus_read(WORD address)
 {
+    // 读 PRG-ROM 不会被 PPU/APU 观察到, 其余 I/O 读取之前先让 PPU/APU 追上当前周期
+    if (address < 0x8000) {
+        cpu_sync();
+    }
+
     if (address >= 0x2000 && address <= 0x3FFF) {
         return ppu_read(address & 0x2007);
     }
@@ -45,6 +85,20 @@ static inline BYTE slow_bus_read(WORD address)
     }
 
     if (address >= 0x8000) {
+        if (cdl_enabled) {
+            cdl_log_prg(address, CDL_PRG_DATA);
+        }
+
+        // bank 切换之后第一次读 PRG-ROM 时重新建立页表
+        if (!prg_pages_ready) {
+            update_prg_pages();
+
+            BYTE *page = read_page_ptr[address >> 8];
+            if (page) {
+                return page[address & 0xFF];
+            }
+        }
+
         return prg_rom_read(address);
     }
 
@@ -53,6 +107,9 @@ static inline BYTE slow_bus_read(WORD address)
 
 static inline void slow_bus_write(WORD address, BYTE data)
 {
+    // 寄存器和 mapper 的写入都会影响 PPU/APU, 先追上当前周期
+    cpu_sync();
+
     if (address >= 0x2000 && address <= 0x3FFF) {
         ppu_write(address & 0x2007, data);
         return;
@@ -65,10 +122,12 @@ static inline void slow_bus_write(WORD address, BYTE data)
             BYTE value = bus_read(dma_address + x);
             cpu_clock();
 
+            cpu_sync();
             ppu.oam[(ppu.oamaddr + x) & 0xFF] = value;
             cpu_clock();
         }
 
+        cpu_sync();
         ppu_invalidate_sprite_cache();
 
         if (cpu.cycle & 0x1) {
@@ -104,30 +163,103 @@ static inline void slow_bus_write(WORD address, BYTE data)
     }
 }
 
+// 可以直接用指针访问的页: 内部 RAM、拓展 rom 和 SRAM, 其余返回 NULL
+static BYTE *direct_page_ptr(int page)
+{
+    if (page <= 0x1F) {
+        return cpu.ram + (((page << 8) & 0x7FF));
+    }
+
+    if (page >= 0x41 && page <= 0x5F) {
+        return extend_rom + (((page - 0x40) << 8));
+    }
+
+    if (page >= 0x60 && page <= 0x7F) {
+        return sram + (((page - 0x60) << 8));
+    }
+
+    return NULL;
+}
+
 void bus_init_page_cache()
 {
     memset(read_page_ptr, 0, sizeof(read_page_ptr));
     memset(write_page_ptr, 0, sizeof(write_page_ptr));
 
-    for (int page = 0x00; page <= 0x1F; ++page) {
-        BYTE *ram_page = cpu.ram + (((page << 8) & 0x7FF));
-        read_page_ptr[page] = ram_page;
-        write_page_ptr[page] = ram_page;
+    for (int page = 0x00; page <= 0x7F; ++page) {
+        BYTE *direct_page = direct_page_ptr(page);
+        read_page_ptr[page] = watch_read_pages[page] ? NULL : direct_page;
+        write_page_ptr[page] = watch_write_pages[page] ? NULL : direct_page;
+    }
+
+    prg_pages_ready = 0;
+    page_cache_ready = 1;
+}
+
+/*
+* 设置有观察点的页, 全为 0 时恢复原来的页表.
+* $0000-$01FF 的零页和栈访问不查页表, 这两页有观察点时由 bus_watch_low 让它们也走 bus_read/bus_write.
+* 零页和栈在 $0800、$1000、$1800 处的镜像页有观察点时也一样
+*/
+void bus_set_watch_pages(const BYTE read_pages[0x100], const BYTE write_pages[0x100])
+{
+    memcpy(watch_read_pages, read_pages, sizeof(watch_read_pages));
+    memcpy(watch_write_pages, write_pages, sizeof(watch_write_pages));
+
+    bus_watch_low = 0;
+    for (int page = 0x00; page < 0x20; page++) {
+        if ((page & 0x07) <= 0x01 && (read_pages[page] || write_pages[page])) {
+            bus_watch_low = 1;
+        }
     }
 
-    for (int page = 0x41; page <= 0x5F; ++page) {
-        BYTE *expansion_page = extend_rom + (((page - 0x40) << 8));
-        read_page_ptr[page] = expansion_page;
-        write_page_ptr[page] = expansion_page;
+    bus_init_page_cache();
+}
+
+static BYTE watched_bus_read(WORD address)
+{
+    BYTE *page = direct_page_ptr(address >> 8);
+    BYTE data = page ? page[address & 0xFF] : slow_bus_read(address);
+
+    debug_check_access(address, DEBUG_READ, data);
+
+    return data;
+}
+
+static void watched_bus_write(WORD address, BYTE data)
+{
+    debug_check_access(address, DEBUG_WRITE, data);
+
+    BYTE *page = direct_page_ptr(address >> 8);
+    if (page) {
+        page[address & 0xFF] = data;
+        return;
     }
 
-    for (int page = 0x60; page <= 0x7F; ++page) {
-        BYTE *sram_page = sram + (((page - 0x60) << 8));
-        read_page_ptr[page] = sram_page;
-        write_page_ptr[page] = sram_page;
+    slow_bus_write(address, data);
+}
+
+/*
+* 只读取不产生副作用的地方: 内部 RAM、拓展 rom、SRAM 和 mapper 当前映射的 PRG-ROM,
+* 不让 PPU/APU 追赶, 不触发观察点, 也不做代码/数据记录. PPU/APU 等寄存器返回 0.
+* 给调试器和指令记录读取指令字节用
+*/
+BYTE bus_peek(WORD address)
+{
+    BYTE *page = direct_page_ptr(address >> 8);
+    if (page) {
+        return page[address & 0xFF];
     }
 
-    page_cache_ready = 1;
+    if (address >= 0x4020 && address <= 0x40FF) {
+        return extend_rom[address - 0x4020];
+    }
+
+    if (address >= 0x8000) {
+        return prg_rom_read(address);
+    }
+
+    return 0;
 }
 
 static inline void ensure_page_cache()
@@ -146,6 +278,10 @@ BYTE bus_read(WORD address)
         return page[address & 0xFF];
     }
 
+    if (watch_read_pages[address >> 8]) {
+        return watched_bus_read(address);
+    }
+
     return slow_bus_read(address);
 }
 
@@ -159,5 +295,10 @@ void bus_write(WORD address, BYTE data)
         return;
     }
 
+    if (watch_write_pages[address >> 8]) {
+        watched_bus_write(address, data);
+        return;
+    }
+
     slow_bus_write(address, data);
 }
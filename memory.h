@@ -4,6 +4,9 @@
 
 BYTE bus_read(WORD address);
 void bus_write(WORD address, BYTE data);
+BYTE bus_peek(WORD address);
 void bus_init_page_cache();
+void bus_invalidate_prg_pages();
+void bus_set_watch_pages(const BYTE read_pages[0x100], const BYTE write_pages[0x100]);
 
 #endif
@@ -0,0 +1,154 @@
+#include "pixel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_X86
+#include <immintrin.h>
+#endif
+
+static void expand_planes_scalar(const BYTE *lsb, const BYTE *msb, int count, BYTE *pixels)
+{
+    for (int i = 0; i < count; ++i) {
+        for (int pixel = 0; pixel < 8; ++pixel) {
+            pixels[i * 8 + pixel] = ((msb[i] >> (7 - pixel)) & 1) << 1 | ((lsb[i] >> (7 - pixel)) & 1);
+        }
+    }
+}
+
+static void palette_lookup_scalar(const BYTE *indices, const uint32_t *palette, int count, uint32_t *out)
+{
+    for (int i = 0; i < count; ++i) {
+        out[i] = palette[indices[i]];
+    }
+}
+
+static SDL_bool always_supported()
+{
+    return SDL_TRUE;
+}
+
+#ifdef PIXEL_X86
+
+/*
+* 每个字节复制到 8 个位置, 和 0x80、0x40 ... 0x01 相与后再比较, 就得到每一位是否为 1.
+* SSE2 一次展开 2 个字节, AVX2 一次 4 个
+*/
+__attribute__((target("sse2")))
+static void expand_planes_sse2(const BYTE *lsb, const BYTE *msb, int count, BYTE *pixels)
+{
+    const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    const __m128i one = _mm_set1_epi8(1);
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        __m128i l = _mm_cvtsi32_si128(lsb[i] | lsb[i + 1] << 8);
+        __m128i m = _mm_cvtsi32_si128(msb[i] | msb[i + 1] << 8);
+
+        l = _mm_unpacklo_epi8(l, l);
+        l = _mm_unpacklo_epi16(l, l);
+        l = _mm_unpacklo_epi32(l, l);
+        m = _mm_unpacklo_epi8(m, m);
+        m = _mm_unpacklo_epi16(m, m);
+        m = _mm_unpacklo_epi32(m, m);
+
+        l = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(l, bits), bits), one);
+        m = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(m, bits), bits), one);
+
+        _mm_storeu_si128((__m128i *)&pixels[i * 8], _mm_or_si128(l, _mm_add_epi8(m, m)));
+    }
+
+    expand_planes_scalar(lsb + i, msb + i, count - i, pixels + i * 8);
+}
+
+// SSE2 没有按索引取数的指令, 一次查 16 个, 每 4 个拼成一个向量写出
+__attribute__((target("sse2")))
+static void palette_lookup_sse2(const BYTE *indices, const uint32_t *palette, int count, uint32_t *out)
+{
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        for (int j = 0; j < 16; j += 4) {
+            const BYTE *index = &indices[i + j];
+            __m128i colors = _mm_set_epi32(palette[index[3]], palette[index[2]], palette[index[1]], palette[index[0]]);
+            _mm_storeu_si128((__m128i *)&out[i + j], colors);
+        }
+    }
+
+    palette_lookup_scalar(indices + i, palette, count - i, out + i);
+}
+
+static SDL_bool sse2_supported()
+{
+    return SDL_HasSSE2();
+}
+
+__attribute__((target("avx2")))
+static void expand_planes_avx2(const BYTE *lsb, const BYTE *msb, int count, BYTE *pixels)
+{
+    const __m256i bits = _mm256_set1_epi64x(0x0102040810204080LL);
+    const __m256i one = _mm256_set1_epi8(1);
+    // 每个 128 位的半边各取两个字节, 低半边取第 0、1 个, 高半边取第 2、3 个
+    const __m256i spread = _mm256_set_epi64x(0x0303030303030303LL, 0x0202020202020202LL,
+        0x0101010101010101LL, 0x0000000000000000LL);
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32_t l4, m4;
+        memcpy(&l4, &lsb[i], 4);
+        memcpy(&m4, &msb[i], 4);
+
+        __m256i l = _mm256_shuffle_epi8(_mm256_set1_epi32(l4), spread);
+        __m256i m = _mm256_shuffle_epi8(_mm256_set1_epi32(m4), spread);
+
+        l = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(l, bits), bits), one);
+        m = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(m, bits), bits), one);
+
+        _mm256_storeu_si256((__m256i *)&pixels[i * 8], _mm256_or_si256(l, _mm256_add_epi8(m, m)));
+    }
+
+    expand_planes_sse2(lsb + i, msb + i, count - i, pixels + i * 8);
+}
+
+// 一次查 32 个: 32 个索引零扩展成 4 组 8 个 32 位整数, 各做一次 gather
+__attribute__((target("avx2")))
+static void palette_lookup_avx2(const BYTE *indices, const uint32_t *palette, int count, uint32_t *out)
+{
+    int i = 0;
+
+    for (; i + 32 <= count; i += 32) {
+        for (int j = 0; j < 32; j += 8) {
+            __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&indices[i + j]));
+            __m256i colors = _mm256_i32gather_epi32((const int *)palette, index, 4);
+            _mm256_storeu_si256((__m256i *)&out[i + j], colors);
+        }
+    }
+
+    palette_lookup_sse2(indices + i, palette, count - i, out + i);
+}
+
+static SDL_bool avx2_supported()
+{
+    return SDL_HasAVX2();
+}
+
+#endif
+
+// 按从慢到快的顺序排列
+const PIXEL_KERNELS pixel_kernel_table[] = {
+    { "scalar", always_supported, expand_planes_scalar, palette_lookup_scalar },
+#ifdef PIXEL_X86
+    { "sse2", sse2_supported, expand_planes_sse2, palette_lookup_sse2 },
+    { "avx2", avx2_supported, expand_planes_avx2, palette_lookup_avx2 },
+#endif
+};
+
+const int pixel_kernel_count = sizeof(pixel_kernel_table) / sizeof(pixel_kernel_table[0]);
+const PIXEL_KERNELS *pixel_kernels = &pixel_kernel_table[0];
+
+void pixel_init()
+{
+    for (int i = 0; i < pixel_kernel_count; i++) {
+        if (pixel_kernel_table[i].supported()) {
+            pixel_kernels = &pixel_kernel_table[i];
+        }
+    }
+}
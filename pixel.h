@@ -0,0 +1,27 @@
+#ifndef __PIXEL_HEADER__
+#define __PIXEL_HEADER__
+#include "common.h"
+
+/*
+* ppu 的像素处理函数: 位平面展开成像素值, 颜色索引查表转成 ARGB.
+* 每组函数都有普通 C 的版本, x86 上另有 SSE2 和 AVX2 的版本, pixel_init 按 cpu 支持的指令集选最快的一组
+*/
+typedef struct
+{
+    const char *name;
+    SDL_bool (*supported)();
+
+    // count 个字节的低/高位平面展开成 count * 8 个 0-3 的像素值, 最高位在前
+    void (*expand_planes)(const BYTE *lsb, const BYTE *msb, int count, BYTE *pixels);
+
+    // count 个颜色索引查 palette 转成 ARGB
+    void (*palette_lookup)(const BYTE *indices, const uint32_t *palette, int count, uint32_t *out);
+}PIXEL_KERNELS;
+
+extern const PIXEL_KERNELS pixel_kernel_table[];
+extern const int pixel_kernel_count;
+extern const PIXEL_KERNELS *pixel_kernels;
+
+void pixel_init();
+
+#endif
@@ -1,5 +1,7 @@
 
 #include "ppu.h"
+#include "cdl.h"
+#include "pixel.h"
 #include <SDL2/SDL.h>
 
 SDL_Renderer *current_renderer = NULL;
@@ -134,6 +136,147 @@ uint32_t rgb_palette[64] = {
 static BG_TILE_CACHE bg_tile_cache = { .scanline = -1 };
 static SPRITE_SCANLINE_CACHE sprite_scanline_cache = { .scanline = -1 };
 
+/*
+* 一帧画面按调色板索引保存, 每个点一个字节: 低 6 位是颜色, 没有画过的点是 PPU_BLANK_PIXEL(显示为黑色).
+* 每条扫描线另外记下画这条线时的 PPUMASK, 强调色和灰度在送去显示时查表处理.
+* 精灵和背景比较时要用的背景像素值放在 bg_line 里, 只保存当前这条扫描线
+*/
+static BYTE frame_pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+static BYTE frame_masks[SCREEN_HEIGHT];
+static BYTE bg_line[SCREEN_WIDTH];
+
+/*
+* 8 种强调色组合, 每种 64 个颜色, 最后一项是 PPU_BLANK_PIXEL 的黑色.
+* 强调的颜色以外的两个分量压暗到 3/4: 第 5 位强调红色, 第 6 位绿色, 第 7 位蓝色
+*/
+static uint32_t color_lut[8][PPU_BLANK_PIXEL + 1];
+
+static void build_color_lut()
+{
+    for (int emphasis = 0; emphasis < 8; ++emphasis) {
+        for (int i = 0; i < 64; ++i) {
+            uint32_t r = (rgb_palette[i] >> 16) & 0xFF;
+            uint32_t g = (rgb_palette[i] >> 8) & 0xFF;
+            uint32_t b = rgb_palette[i] & 0xFF;
+
+            if (emphasis & 0x1) {
+                g = g * 3 / 4;
+                b = b * 3 / 4;
+            }
+            if (emphasis & 0x2) {
+                r = r * 3 / 4;
+                b = b * 3 / 4;
+            }
+            if (emphasis & 0x4) {
+                r = r * 3 / 4;
+                g = g * 3 / 4;
+            }
+
+            color_lut[emphasis][i] = (rgb_palette[i] & 0xFF000000) | r << 16 | g << 8 | b;
+        }
+
+        color_lut[emphasis][PPU_BLANK_PIXEL] = 0;
+    }
+}
+
+// 画到这条扫描线时记下当前的强调色和灰度, 行中间改了 PPUMASK 时以最后画的点为准
+static inline BYTE *get_frame_line(int scanline)
+{
+    frame_masks[scanline] = ppu.ppumask;
+    return &frame_pixels[scanline * SCREEN_WIDTH];
+}
+
+// 从 x 开始到行尾清成没有画过, 背景像素值都是透明
+static void clear_scanline(int scanline, int x)
+{
+    memset(&get_frame_line(scanline)[x], PPU_BLANK_PIXEL, SCREEN_WIDTH - x);
+    memset(&bg_line[x], 0, SCREEN_WIDTH - x);
+}
+
+/*
+* 可见扫描线在第 0 个点按当时的滚动、mask 和缓存一次画完整条线, 后面的点只做滚动更新和 sprite 0 命中.
+* 行中间 cpu 改了会影响画面的状态时, 这一行剩下的点回到逐点渲染
+*/
+static int batched_scanline = -1;        // 已经整条画好的扫描线, -1 表示没有
+static int sprite_zero_hit_dot = SCREEN_WIDTH;
+
+static void split_batched_scanline()
+{
+    if (batched_scanline < 0 || batched_scanline != ppu.scanline) {
+        return;
+    }
+
+    batched_scanline = -1;
+
+    // 还没有走到的点清掉, 和逐点渲染时一样从空白开始画
+    if (ppu.cycle < SCREEN_WIDTH) {
+        clear_scanline(ppu.scanline, ppu.cycle);
+    }
+}
+
+/*
+* 解码好的 CHR 图案: 每个 16 字节的图块按行展开成 8 行 x 8 个像素值(0-3), 另外存一份水平翻转的给精灵用.
+* 按 CHR 的物理偏移存放, mapper 切换 bank 时不用失效. CHR-ROM 在 reset 时整个解码一次,
+* CHR-RAM 写入时只重新解码写到的那一行
+*/
+#define CHR_TILE_ROW_BYTES (8)
+#define CHR_TILE_BYTES (CHR_TILE_ROW_BYTES * 8)
+
+static BYTE *chr_tiles = NULL;
+static BYTE *chr_tiles_flipped = NULL;
+static size_t chr_size = 0;
+static BYTE chr_is_ram = 0;
+
+static inline const BYTE *chr_data()
+{
+    return chr_is_ram ? ppu.vram : get_current_rom()->chr_rom;
+}
+
+static inline void flip_tile_rows(const BYTE *pixels, int rows, BYTE *flipped)
+{
+    for (int i = 0; i < rows * CHR_TILE_ROW_BYTES; i += CHR_TILE_ROW_BYTES) {
+        for (int pixel = 0; pixel < 8; ++pixel) {
+            flipped[i + 7 - pixel] = pixels[i + pixel];
+        }
+    }
+}
+
+// 解码 offset 所在图块的一行, 两个位平面在图块里相隔 8 个字节
+static void decode_chr_row(size_t offset)
+{
+    size_t row_offset = offset & ~(size_t)0x08;
+    size_t index = (row_offset >> 4) * CHR_TILE_BYTES + (row_offset & 0x07) * CHR_TILE_ROW_BYTES;
+    const BYTE *data = chr_data();
+
+    pixel_kernels->expand_planes(&data[row_offset], &data[row_offset + 8], 1, &chr_tiles[index]);
+    flip_tile_rows(&chr_tiles[index], 1, &chr_tiles_flipped[index]);
+}
+
+static void decode_chr_tiles()
+{
+    ROM *rom = get_current_rom();
+
+    chr_is_ram = rom->header->chr_rom_count == 0;
+    chr_size = chr_is_ram ? 0x2000 : (size_t)rom->header->chr_rom_count * CHR_ROM_PAGE_SIZE;
+
+    FREE(chr_tiles);
+    FREE(chr_tiles_flipped);
+    chr_tiles = malloc(chr_size / 16 * CHR_TILE_BYTES);
+    chr_tiles_flipped = malloc(chr_size / 16 * CHR_TILE_BYTES);
+    if (!chr_tiles || !chr_tiles_flipped) {
+        fprintf(stderr, "alloc chr tile cache failed!\n");
+        exit(-1);
+    }
+
+    const BYTE *data = chr_data();
+    for (size_t offset = 0; offset < chr_size; offset += 16) {
+        size_t index = (offset >> 4) * CHR_TILE_BYTES;
+
+        pixel_kernels->expand_planes(&data[offset], &data[offset + 8], 8, &chr_tiles[index]);
+        flip_tile_rows(&chr_tiles[index], 8, &chr_tiles_flipped[index]);
+    }
+}
+
 static inline void invalidate_bg_tile_cache()
 {
     bg_tile_cache.scanline = -1;
@@ -141,6 +284,8 @@ static inline void invalidate_bg_tile_cache()
 
 void ppu_invalidate_sprite_cache()
 {
+    split_batched_scanline();
+
     sprite_scanline_cache.scanline = -1;
     sprite_scanline_cache.valid = 0;
     sprite_scanline_cache.count = 0;
@@ -155,6 +300,11 @@ void ppu_invalidate_render_cache()
 void ppu_reset()
 {
     memset(&ppu, 0, sizeof(_PPU));
+    batched_scanline = -1;
+
+    // reset 时多半是从一帧的中间开始画, 前面画不到的地方显示为黑色
+    memset(frame_pixels, PPU_BLANK_PIXEL, sizeof(frame_pixels));
+    memset(frame_masks, 0, sizeof(frame_masks));
 
     ppu.scanline = 0;
     ppu.cycle = 24;
@@ -167,6 +317,8 @@ void ppu_reset()
     uint8_t chr_rom_count = get_current_rom()->header->chr_rom_count;
     memcpy(ppu.vram, get_current_rom()->chr_rom, (chr_rom_count & 0x1) * CHR_ROM_PAGE_SIZE);
 
+    decode_chr_tiles();
+
     BYTE mirroring = get_current_rom()->header->flag1;
 
     // 假设 header[6] 的第 0 位决定水平或垂直镜像
@@ -184,6 +336,8 @@ void ppu_reset()
 
 void ppu_init()
 {
+    pixel_init();
+    build_color_lut();
     ppu_reset();
 
     // 这里使用rgb 调色板的索引即可.
@@ -257,16 +411,23 @@ WORD get_palette_address(WORD address)
     return address;
 }
 
+// 灰度模式下只保留颜色的亮度位
 BYTE read_palette(WORD address)
 {
+    WORD real_address = get_palette_address(address);
     if (ppu.ppumask & 0x1) {
-        return 0x30;
+        return ppu.vram[real_address] & 0x30;
     }
 
-    WORD real_address = get_palette_address(address);
     return ppu.vram[real_address];
 }
 
+// 渲染用的颜色, 灰度在显示时处理
+static inline BYTE palette_color(BYTE index)
+{
+    return ppu.vram[get_palette_address(0x3F00 + index)] & 0x3F;
+}
+
 // 读取 VRAM
 BYTE ppu_vram_read(WORD address)
 {
@@ -301,6 +462,10 @@ void ppu_vram_write(WORD address, BYTE data)
 
     if (address < 0x2000) {
         chr_rom_write(address, data);
+
+        if (chr_is_ram) {
+            decode_chr_row(address);
+        }
     } else if (address < 0x3F00) {
         // Name tables 和 Attribute tables 区域
         if (address >= 0x3000) {
@@ -345,6 +510,7 @@ BYTE ppu_read(WORD address)
             }
 
             ppu.v += (ppu.ppuctrl & 0x04) ? 32 : 1; // 垂直/水平增量模式
+            split_batched_scanline();
             break;
 
         default:
@@ -357,6 +523,8 @@ BYTE ppu_read(WORD address)
 
 void ppu_write(WORD address, uint8_t data)
 {
+    split_batched_scanline();
+
     switch (address) {
         case 0x2000: // PPUCTRL
             ppu.ppuctrl = data;
@@ -422,6 +590,30 @@ void ppu_write(WORD address, uint8_t data)
     }
 }
 
+/*
+* PPU 图案地址 address(低位平面) 那一行的 8 个像素值.
+* bank 号超出 CHR 大小时没有解码好的数据, 按原来的方式读两个位平面解码到 buffer 里
+*/
+static inline const BYTE *get_chr_tile_row(WORD address, BYTE flip_horizontal, BYTE *buffer)
+{
+    size_t offset = chr_is_ram ? (address & 0x1FFF) : chr_rom_offset(address);
+    if (offset < chr_size) {
+        size_t index = (offset >> 4) * CHR_TILE_BYTES + (offset & 0x07) * CHR_TILE_ROW_BYTES;
+        return flip_horizontal ? &chr_tiles_flipped[index] : &chr_tiles[index];
+    }
+
+    BYTE lsb = ppu_vram_read(address);
+    BYTE msb = ppu_vram_read(address + 8);
+    BYTE pixels[8];
+
+    pixel_kernels->expand_planes(&lsb, &msb, 1, flip_horizontal ? pixels : buffer);
+    if (flip_horizontal) {
+        flip_tile_rows(pixels, 1, buffer);
+    }
+
+    return buffer;
+}
+
 static inline WORD get_name_table_base()
 {
     return 0x2000 | (ppu.v & 0x0FFF);
@@ -442,23 +634,9 @@ static inline uint32_t get_bg_tile_cache_key(uint16_t v)
     return (uint32_t)v | ((uint32_t)(ppu.ppuctrl & 0x10) << 12);
 }
 
-static BG_TILE_CACHE_ENTRY *get_bg_tile_cache_entry(int screen_x, int scanline)
+// 第 slot 个图块, v 是取这个图块时的地址
+static BG_TILE_CACHE_ENTRY *fetch_bg_tile(int slot, uint16_t v)
 {
-    ensure_bg_tile_cache(scanline);
-
-    uint16_t v = ppu.v;
-    uint8_t x_offset = (screen_x & 0x07) + ppu.x;
-    if (x_offset > 7) {
-        v = increment_horizontal_scroll(v);
-    }
-
-    int slot = (screen_x + ppu.x) >> 3;
-    if (slot < 0) {
-        slot = 0;
-    } else if (slot >= BG_TILE_CACHE_SLOTS) {
-        slot = BG_TILE_CACHE_SLOTS - 1;
-    }
-
     BG_TILE_CACHE_ENTRY *entry = &bg_tile_cache.entries[slot];
     uint32_t key = get_bg_tile_cache_key(v);
     if (entry->valid && entry->key == key) {
@@ -477,28 +655,52 @@ static BG_TILE_CACHE_ENTRY *get_bg_tile_cache_entry(int screen_x, int scanline)
     uint8_t palette_index = (attribute_byte >> shift) & 0x03;
     uint16_t pattern_table_address = ((ppu.ppuctrl & 0x10) ? 0x1000 : 0x0000) +
         tile_index * 16 + fine_y;
-    uint8_t tile_lsb = ppu_vram_read(pattern_table_address);
-    uint8_t tile_msb = ppu_vram_read(pattern_table_address + 8);
-    uint8_t backdrop = ppu_vram_read(0x3F00);
+    BYTE buffer[8];
+    const BYTE *pixels = get_chr_tile_row(pattern_table_address, 0, buffer);
+
+    if (cdl_enabled) {
+        cdl_log_chr(pattern_table_address, CDL_CHR_BG);
+        cdl_log_chr(pattern_table_address + 8, CDL_CHR_BG);
+    }
+
+    // 像素值 0 用背景色, 其它用图块的调色板
+    uint8_t colors[4];
+    colors[0] = palette_color(0);
+    for (int i = 1; i < 4; ++i) {
+        colors[i] = palette_color((palette_index << 2) + i);
+    }
 
     entry->key = key;
     entry->valid = 1;
 
+    memcpy(entry->pixel_values, pixels, 8);
     for (int pixel = 0; pixel < 8; ++pixel) {
-        uint8_t pixel_value = ((tile_msb >> (7 - pixel)) & 1) << 1 |
-            ((tile_lsb >> (7 - pixel)) & 1);
-
-        entry->pixel_values[pixel] = pixel_value;
-        if (pixel_value == 0) {
-            entry->color_indices[pixel] = backdrop;
-        } else {
-            entry->color_indices[pixel] = ppu_vram_read(0x3F00 + (palette_index << 2) + pixel_value);
-        }
+        entry->color_indices[pixel] = colors[pixels[pixel]];
     }
 
     return entry;
 }
 
+static BG_TILE_CACHE_ENTRY *get_bg_tile_cache_entry(int screen_x, int scanline)
+{
+    ensure_bg_tile_cache(scanline);
+
+    uint16_t v = ppu.v;
+    uint8_t x_offset = (screen_x & 0x07) + ppu.x;
+    if (x_offset > 7) {
+        v = increment_horizontal_scroll(v);
+    }
+
+    int slot = (screen_x + ppu.x) >> 3;
+    if (slot < 0) {
+        slot = 0;
+    } else if (slot >= BG_TILE_CACHE_SLOTS) {
+        slot = BG_TILE_CACHE_SLOTS - 1;
+    }
+
+    return fetch_bg_tile(slot, v);
+}
+
 static void prepare_sprite_scanline_cache(int scanline)
 {
     if (sprite_scanline_cache.valid && sprite_scanline_cache.scanline == scanline) {
@@ -550,28 +752,30 @@ static void prepare_sprite_scanline_cache(int scanline)
             pattern_table_address = ((ppu.ppuctrl & 0x08) ? 0x1000 : 0) | (tile_id << 4);
         }
 
-        uint8_t tile_lsb = ppu_vram_read(pattern_table_address + v_y);
-        uint8_t tile_msb = ppu_vram_read(pattern_table_address + v_y + 8);
-        uint8_t palette_index = (attributes & 0x03) + 4;
+        BYTE buffer[8];
         BYTE flip_horizontal = attributes & 0x40;
+        const BYTE *pixels = get_chr_tile_row(pattern_table_address + v_y, flip_horizontal, buffer);
 
-        for (int x = 0; x < 8; ++x) {
-            int h_x = flip_horizontal ? (7 - x) : x;
-            uint8_t pixel_value = ((tile_msb >> (7 - h_x)) & 1) << 1 |
-                ((tile_lsb >> (7 - h_x)) & 1);
+        if (cdl_enabled) {
+            cdl_log_chr(pattern_table_address + v_y, CDL_CHR_SPRITE);
+            cdl_log_chr(pattern_table_address + v_y + 8, CDL_CHR_SPRITE);
+        }
+        uint8_t palette_index = (attributes & 0x03) + 4;
 
-            entry->pixel_values[x] = pixel_value;
-            if (pixel_value == 0) {
-                entry->color_indices[x] = 0;
-            } else {
-                entry->color_indices[x] = ppu_vram_read(0x3F00 + PALETTE_ADDR(palette_index, pixel_value));
-            }
+        uint8_t colors[4] = {0};
+        for (int i = 1; i < 4; ++i) {
+            colors[i] = palette_color(PALETTE_ADDR(palette_index, i));
+        }
+
+        memcpy(entry->pixel_values, pixels, 8);
+        for (int x = 0; x < 8; ++x) {
+            entry->color_indices[x] = colors[pixels[x]];
         }
     }
 }
 
 /* 根据扫描线来渲染背景 */
-void render_background_pixel(PIXEL* frame_buffer, int cycle, int scanline)
+void render_background_pixel(int cycle, int scanline)
 {
     int screen_x = cycle;
     if (!IS_VISIBLE(screen_x, scanline)) {
@@ -579,9 +783,8 @@ void render_background_pixel(PIXEL* frame_buffer, int cycle, int scanline)
     }
 
     if (!is_background_pixel_visible(screen_x)) {
-        uint8_t backdrop = ppu_vram_read(0x3F00);
-        frame_buffer[scanline * SCREEN_WIDTH + screen_x].color = rgb_palette[backdrop];
-        frame_buffer[scanline * SCREEN_WIDTH + screen_x].value = 0;
+        get_frame_line(scanline)[screen_x] = palette_color(0);
+        bg_line[screen_x] = 0;
         return;
     }
 
@@ -590,8 +793,8 @@ void render_background_pixel(PIXEL* frame_buffer, int cycle, int scanline)
     uint8_t pixel_value = entry->pixel_values[pixel_x_in_tile];
     uint8_t color_index = entry->color_indices[pixel_x_in_tile];
 
-    frame_buffer[scanline * SCREEN_WIDTH + screen_x].color = rgb_palette[color_index];
-    frame_buffer[scanline * SCREEN_WIDTH + screen_x].value = pixel_value;
+    get_frame_line(scanline)[screen_x] = color_index;
+    bg_line[screen_x] = pixel_value;
 }
 
 void detected_sprite_overflow(int scanline)
@@ -599,7 +802,7 @@ void detected_sprite_overflow(int scanline)
     prepare_sprite_scanline_cache(scanline);
 }
 
-void render_sprite_pixel(PIXEL* frame_buffer, int cycle,  int scanline)
+void render_sprite_pixel(int cycle,  int scanline)
 {
     BYTE sprite_0_hit_detected = 0;
     int screen_x = cycle;
@@ -610,7 +813,7 @@ void render_sprite_pixel(PIXEL* frame_buffer, int cycle,  int scanline)
 
     prepare_sprite_scanline_cache(scanline);
 
-    uint8_t background_color = frame_buffer[scanline * SCREEN_WIDTH + screen_x].value;
+    uint8_t background_color = bg_line[screen_x];
 
     for (int idx = sprite_scanline_cache.count - 1; idx >= 0; --idx) {
         SPRITE_SCANLINE_CACHE_ENTRY *entry = &sprite_scanline_cache.entries[idx];
@@ -626,8 +829,7 @@ void render_sprite_pixel(PIXEL* frame_buffer, int cycle,  int scanline)
 
         uint8_t bg_color = background_color;
         if (!entry->sprite_behind_background || IS_TRANSPARENT(bg_color)) {
-            frame_buffer[scanline * SCREEN_WIDTH + screen_x].color = rgb_palette[entry->color_indices[x]];
-            frame_buffer[scanline * SCREEN_WIDTH + screen_x].value = pixel_value;
+            get_frame_line(scanline)[screen_x] = entry->color_indices[x];
         }
 
         if (is_background_pixel_visible(screen_x) && entry->sprite_index == 0 && !IS_TRANSPARENT(bg_color)) {
@@ -644,6 +846,88 @@ void render_sprite_pixel(PIXEL* frame_buffer, int cycle,  int scanline)
     }
 }
 
+/* 整条扫描线一次画完, 和逐点渲染的结果一样, 返回 sprite 0 命中的点, 没有命中时返回 SCREEN_WIDTH */
+int render_scanline(int scanline)
+{
+    BYTE *line = get_frame_line(scanline);
+    int hit_dot = SCREEN_WIDTH;
+
+    if (!is_visible_background()) {
+        clear_scanline(scanline, 0);
+    } else {
+        int start = 0;
+
+        if (!(ppu.ppumask & 0x02)) {
+            uint8_t backdrop = palette_color(0);
+            for (int x = 0; x < 8; ++x) {
+                line[x] = backdrop;
+                bg_line[x] = 0;
+            }
+            start = 8;
+        }
+
+        // 逐点渲染时第 x 个点用的是从 ppu.v 开始水平加 (x + ppu.x) / 8 次的图块
+        BG_TILE_CACHE_ENTRY *tiles[BG_TILE_CACHE_SLOTS];
+        int first_slot = (start + ppu.x) >> 3;
+        int last_slot = (SCREEN_WIDTH - 1 + ppu.x) >> 3;
+        uint16_t v = ppu.v;
+
+        ensure_bg_tile_cache(scanline);
+        for (int slot = 0; slot <= last_slot; ++slot) {
+            if (slot >= first_slot) {
+                tiles[slot] = fetch_bg_tile(slot, v);
+            }
+            v = increment_horizontal_scroll(v);
+        }
+
+        for (int x = start; x < SCREEN_WIDTH; ++x) {
+            int position = x + ppu.x;
+            BG_TILE_CACHE_ENTRY *entry = tiles[position >> 3];
+
+            line[x] = entry->color_indices[position & 0x07];
+            bg_line[x] = entry->pixel_values[position & 0x07];
+        }
+    }
+
+    if (!is_visible_sprites()) {
+        return hit_dot;
+    }
+
+    prepare_sprite_scanline_cache(scanline);
+
+    int start = (ppu.ppumask & 0x04) ? 0 : 8;
+
+    // 编号小的精灵后画, 覆盖编号大的
+    for (int idx = sprite_scanline_cache.count - 1; idx >= 0; --idx) {
+        SPRITE_SCANLINE_CACHE_ENTRY *entry = &sprite_scanline_cache.entries[idx];
+
+        for (int i = 0; i < 8; ++i) {
+            int x = entry->x_position + i;
+            if (x < start || x >= SCREEN_WIDTH) {
+                continue;
+            }
+
+            uint8_t pixel_value = entry->pixel_values[i];
+            if (IS_TRANSPARENT(pixel_value)) {
+                continue;
+            }
+
+            uint8_t bg_color = bg_line[x];
+            if (!entry->sprite_behind_background || IS_TRANSPARENT(bg_color)) {
+                line[x] = entry->color_indices[i];
+            }
+
+            // 最后一个点不算命中
+            if (entry->sprite_index == 0 && x < hit_dot && x != 255 &&
+                is_background_pixel_visible(x) && !IS_TRANSPARENT(bg_color)) {
+                hit_dot = x;
+            }
+        }
+    }
+
+    return hit_dot;
+}
+
 void clear_ppu_state()
 {
     ppu.ppustatus &= 0x1F;
@@ -652,23 +936,49 @@ void clear_ppu_state()
     ppu.in_vblank = 0;
 }
 
-void convert_hex(PIXEL* frame_buffer, uint32_t* render_buffer)
+/*
+* 把最近一帧的调色板索引转成 ARGB, pitch 是每行的字节数.
+* 每条扫描线按记下的 PPUMASK 选强调色的颜色表, 灰度时只保留颜色的亮度位
+*/
+void ppu_convert_frame(uint32_t *pixels, int pitch)
 {
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; ++i) {
-        render_buffer[i] = frame_buffer[i].color;
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        const BYTE *line = &frame_pixels[y * SCREEN_WIDTH];
+        BYTE mask = frame_masks[y];
+        BYTE grey_line[SCREEN_WIDTH];
+
+        if (mask & 0x01) {
+            // PPU_BLANK_PIXEL 不受影响
+            for (int x = 0; x < SCREEN_WIDTH; ++x) {
+                grey_line[x] = line[x] & (PPU_BLANK_PIXEL | 0x30);
+            }
+            line = grey_line;
+        }
+
+        uint32_t *row = (uint32_t *)((BYTE *)pixels + y * pitch);
+        pixel_kernels->palette_lookup(line, color_lut[mask >> 5], SCREEN_WIDTH, row);
     }
 }
 
-void display_frame(PIXEL* frame_buffer, SDL_Renderer* renderer, SDL_Texture* texture)
+const BYTE *ppu_frame_pixels()
 {
-    static uint32_t render_buffer[SCREEN_WIDTH * SCREEN_HEIGHT] = {0x00};
-    convert_hex(frame_buffer, render_buffer);
+    return frame_pixels;
+}
+
+const BYTE *ppu_frame_masks()
+{
+    return frame_masks;
+}
 
+void display_frame(SDL_Renderer* renderer, SDL_Texture* texture)
+{
     uint32_t *pixels;
     int pitch;
     if (SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch) == 0) {
-        memcpy(pixels, render_buffer, SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+        ppu_convert_frame(pixels, pitch);
         SDL_UnlockTexture(texture);
+    } else {
+        fprintf(stderr, "lock texture failed: %s\n", SDL_GetError());
     }
 
     // 清除渲染器
@@ -698,6 +1008,7 @@ void update_timing()
 
     ppu.cycle = 0;
     ppu.scanline++;
+    batched_scanline = -1;
 
     if (ppu.scanline == 240) {
         ppu.frame_count += 1;
@@ -714,17 +1025,8 @@ void set_SDLdevice(SDL_Renderer* renderer, SDL_Texture* texture)
     current_texture = texture;
 }
 
-void step_ppu()
+static inline void ppu_dot(SDL_Renderer *renderer, SDL_Texture *texture)
 {
-    SDL_Renderer *renderer = current_renderer;
-    SDL_Texture *texture = current_texture;
-
-    if (!renderer || !texture) {
-        return;
-    }
-
-    static PIXEL frame_buffer[SCREEN_WIDTH * SCREEN_HEIGHT] = {0x00};
-
     // 在预渲染扫描线的第一个周期开始新的帧
     if (ppu.scanline == -1) {
 
@@ -752,15 +1054,24 @@ void step_ppu()
 
             if (ppu.cycle == 0) {
                 detected_sprite_overflow(ppu.scanline);
+
+                sprite_zero_hit_dot = render_scanline(ppu.scanline);
+                batched_scanline = ppu.scanline;
             }
 
             if (ppu.cycle >= 0 && ppu.cycle < 256) {
-                if (is_visible_background()) {
-                    render_background_pixel(frame_buffer, ppu.cycle, ppu.scanline);
-                }
-
-                if (is_visible_sprites()) {
-                    render_sprite_pixel(frame_buffer, ppu.cycle, ppu.scanline);
+                if (batched_scanline == ppu.scanline) {
+                    if (ppu.cycle == sprite_zero_hit_dot) {
+                        ppu.ppustatus |= 0x40;
+                    }
+                } else {
+                    if (is_visible_background()) {
+                        render_background_pixel(ppu.cycle, ppu.scanline);
+                    }
+
+                    if (is_visible_sprites()) {
+                        render_sprite_pixel(ppu.cycle, ppu.scanline);
+                    }
                 }
             }
 
@@ -781,9 +1092,13 @@ void step_ppu()
 
     } else {
 
+        // 关闭渲染时可见扫描线也要整行写满
+        if (is_visible_frame() && ppu.cycle == 0) {
+            clear_scanline(ppu.scanline, 0);
+        }
+
         if (ppu.scanline == 240 && ppu.cycle == 1) {
-            display_frame(frame_buffer, renderer, texture);
-            memset(frame_buffer, 0, sizeof(frame_buffer));
+            display_frame(renderer, texture);
         }
 
         // 在VBlank开始时设置VBlank标志并生成NMI中断
@@ -800,3 +1115,156 @@ void step_ppu()
 
     update_timing();
 }
+
+void step_ppu()
+{
+    if (!current_renderer || !current_texture) {
+        return;
+    }
+
+    ppu_dot(current_renderer, current_texture);
+}
+
+#define DOTS_PER_SCANLINE (341)
+#define DOTS_PER_FRAME (DOTS_PER_SCANLINE * 262)
+
+// 以预渲染扫描线(-1) 的第0 个点为起点, 计算一帧内的位置
+static inline int frame_position(int scanline, int cycle)
+{
+    return (scanline + 1) * DOTS_PER_SCANLINE + cycle;
+}
+
+/* 从 (240, 2) 开始到这一帧结束, 除了 (241, 1) 设置 vblank 之外没有任何工作 */
+static inline BYTE is_idle_vblank_dot()
+{
+    if (ppu.scanline == 240 || ppu.scanline == 241) {
+        return ppu.cycle >= 2;
+    }
+
+    return ppu.scanline > 241;
+}
+
+/* 成批跳过空闲的点, 返回跳过的点数 */
+static inline int skip_idle_vblank_dots(int dots)
+{
+    int position = frame_position(ppu.scanline, ppu.cycle);
+    int vblank_position = frame_position(241, 1);
+
+    // 最多跳到 (241, 1) 或者下一帧的开始
+    int end = (position < vblank_position) ? vblank_position : DOTS_PER_FRAME;
+    if (dots > end - position) {
+        dots = end - position;
+    }
+
+    position += dots;
+
+    if (position == DOTS_PER_FRAME) {
+        // 进入下一帧的预渲染扫描线
+        ppu.scanline = -1;
+        ppu.cycle = 0;
+        return dots;
+    }
+
+    ppu.scanline = position / DOTS_PER_SCANLINE - 1;
+    ppu.cycle = position % DOTS_PER_SCANLINE;
+
+    return dots;
+}
+
+void ppu_run(int dots)
+{
+    SDL_Renderer *renderer = current_renderer;
+    SDL_Texture *texture = current_texture;
+
+    if (!renderer || !texture) {
+        return;
+    }
+
+    while (dots > 0) {
+        if (is_idle_vblank_dot()) {
+            dots -= skip_idle_vblank_dots(dots);
+            continue;
+        }
+
+        ppu_dot(renderer, texture);
+        dots--;
+    }
+}
+
+static inline int dots_between(int from, int to)
+{
+    return (to - from + DOTS_PER_FRAME) % DOTS_PER_FRAME;
+}
+
+/*
+* 距离下一个 cpu 可以观察到的 ppu 事件还有多少个点:
+* 帧结束(240, 1)、vblank/NMI(241, 1), 以及开启渲染时每条可见扫描线上 mapper 的 IRQ 计数点(260).
+* 奇数帧会跳过一个点, 所以真实距离可能比返回值少 1.
+*/
+int ppu_dots_to_next_event()
+{
+    int position = frame_position(ppu.scanline, ppu.cycle);
+    int dots = dots_between(position, frame_position(240, 1));
+
+    int vblank_dots = dots_between(position, frame_position(241, 1));
+    if (vblank_dots < dots) {
+        dots = vblank_dots;
+    }
+
+    if (is_rendering_enabled()) {
+        int scanline = ppu.scanline;
+        if (scanline < 0 || ppu.cycle > 260) {
+            scanline++;
+        }
+
+        if (scanline > 239) {
+            scanline = 0;
+        }
+
+        int irq_dots = dots_between(position, frame_position(scanline, 260));
+        if (irq_dots < dots) {
+            dots = irq_dots;
+        }
+    }
+
+    return dots;
+}
+
+/*
+* 距离 $2002 的值可能被 ppu 改变还有多少个点: vblank 置位(241, 1)、预渲染线上的清除(-1, 1),
+* 开启渲染时从第 0 条扫描线开始随时可能设置 sprite 0 命中和溢出标志, 这期间返回 0.
+*/
+int ppu_dots_to_status_change()
+{
+    int position = frame_position(ppu.scanline, ppu.cycle);
+    int dots = dots_between(position, frame_position(241, 1));
+
+    int clear_dots = dots_between(position, frame_position(-1, 1));
+    if (clear_dots < dots) {
+        dots = clear_dots;
+    }
+
+    if (is_rendering_enabled()) {
+        if (ppu.scanline >= 0 && ppu.scanline < 240) {
+            return 0;
+        }
+
+        int visible_dots = dots_between(position, frame_position(0, 0));
+        if (visible_dots < dots) {
+            dots = visible_dots;
+        }
+    }
+
+    return dots;
+}
+
+/*
+* 距离这一帧送去显示还有多少个点, 也就是处理完 (240, 1) 为止.
+* 刚好在 (240, 2) 时要等到下一帧. 奇数帧跳过的那个点只会让真实距离更短.
+*/
+int ppu_dots_to_frame_end()
+{
+    int dots = dots_between(frame_position(ppu.scanline, ppu.cycle), frame_position(240, 2));
+
+    return dots ? dots : DOTS_PER_FRAME;
+}
@@ -3,10 +3,26 @@
 #include "common.h"
 #include "SDL2/SDL.h"
 
+#define PPU_DOTS_PER_CPU_CYCLE (3)
+
 BYTE ppu_read(WORD addr);
 void ppu_write(WORD addr, uint8_t data);
 void ppu_vram_write(WORD address, BYTE data);
 void ppu_invalidate_render_cache();
 void ppu_invalidate_sprite_cache();
+void ppu_run(int dots);
+int ppu_dots_to_next_event();
+int ppu_dots_to_status_change();
+int ppu_dots_to_frame_end();
+
+/*
+* 画面的原始格式: 每个点一个字节的调色板索引(低 6 位), PPU_BLANK_PIXEL 表示没有画过,
+* 每条扫描线一个字节的 PPUMASK(第 0 位灰度, 第 5-7 位强调色). 一帧在扫描线 240 送去显示, 到下一帧开始画之前不变
+*/
+#define PPU_BLANK_PIXEL (0x40)
+
+const BYTE *ppu_frame_pixels();
+const BYTE *ppu_frame_masks();
+void ppu_convert_frame(uint32_t *pixels, int pitch);
 
 #endif
@@ -0,0 +1,396 @@
+#include "profile.h"
+#include "disasm.h"
+#include "memory.h"
+
+/*
+* 采样分析器: 由 cpu 的事件调度器每隔固定的周期数调用一次, 记录当前的 PC 和所在的 PRG bank.
+* 关闭时调度器里没有这个事件, 不会有任何开销; 打开后每次采样只多一次同步.
+* 直方图是固定大小的开放寻址表, 满了以后新的地址只计入 dropped_samples.
+* 指令中间访问 I/O 寄存器时也会同步, 这时记录的是已经前进过的 PC, 会算到紧跟着的地址上.
+*/
+#define PROFILE_TABLE_SIZE (0x4000)
+#define PROFILE_BANK_SIZE (0x2000)
+#define PROFILE_BANK_NONE (0xFFFF) // 不在 PRG-ROM 里, 例如 RAM 里的代码
+
+typedef struct
+{
+    uint32_t key; // bank << 16 | addr, 0 表示空
+    uint32_t count;
+}PROFILE_ENTRY;
+
+static PROFILE_ENTRY profile_table[PROFILE_TABLE_SIZE];
+static uint64_t total_samples = 0;
+static uint64_t dropped_samples = 0;
+
+static inline uint32_t profile_key(WORD addr)
+{
+    uint32_t bank = PROFILE_BANK_NONE;
+    if (addr >= 0x8000) {
+        bank = prg_rom_offset(addr) / PROFILE_BANK_SIZE;
+    }
+
+    // 加 1 避免和空表项冲突
+    return ((bank << 16) | addr) + 1;
+}
+
+void profiler_sample()
+{
+    uint32_t key = profile_key(PC);
+    uint32_t index = (key * 2654435761u) & (PROFILE_TABLE_SIZE - 1);
+
+    total_samples++;
+
+    for (int i = 0; i < PROFILE_TABLE_SIZE; i++) {
+        PROFILE_ENTRY *entry = &profile_table[index];
+
+        if (entry->key == key) {
+            entry->count++;
+            return;
+        }
+
+        if (!entry->key) {
+            entry->key = key;
+            entry->count = 1;
+            return;
+        }
+
+        index = (index + 1) & (PROFILE_TABLE_SIZE - 1);
+    }
+
+    dropped_samples++;
+}
+
+void profiler_start(uint32_t period)
+{
+    memset(profile_table, 0, sizeof(profile_table));
+    total_samples = 0;
+    dropped_samples = 0;
+
+    cpu_set_profile_period(period ? period : PROFILE_DEFAULT_PERIOD);
+}
+
+void profiler_stop()
+{
+    cpu_set_profile_period(0);
+}
+
+static int compare_entry(const void *a, const void *b)
+{
+    const PROFILE_ENTRY *x = a, *y = b;
+
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+
+    return x->key < y->key ? -1 : (x->key > y->key);
+}
+
+// 取出采样地址处的指令字节, PRG-ROM 按记录的 bank 读, 不受之后切换 bank 的影响; 其它地址用 bus_peek, 没有读寄存器的副作用
+static void read_code(uint32_t bank, WORD addr, BYTE *code)
+{
+    ROM *rom = get_current_rom();
+    size_t prg_size = rom->header->prg_rom_count * PRG_ROM_PAGE_SIZE;
+
+    for (int i = 0; i < 3; i++) {
+        if (bank == PROFILE_BANK_NONE) {
+            code[i] = bus_peek(addr + i);
+            continue;
+        }
+
+        size_t offset = bank * PROFILE_BANK_SIZE + ((addr + i) & (PROFILE_BANK_SIZE - 1));
+        code[i] = offset < prg_size ? rom->prg_rom[offset] : 0;
+    }
+}
+
+// 按采样次数从多到少输出 bank:地址、次数、占比和反汇编
+void profiler_dump(FILE *fp)
+{
+    static PROFILE_ENTRY entries[PROFILE_TABLE_SIZE];
+    int count = 0;
+
+    for (int i = 0; i < PROFILE_TABLE_SIZE; i++) {
+        if (profile_table[i].key) {
+            entries[count++] = profile_table[i];
+        }
+    }
+
+    qsort(entries, count, sizeof(PROFILE_ENTRY), compare_entry);
+
+    fprintf(fp, "samples: %" PRIu64 ", dropped: %" PRIu64 ", addresses: %d\n", total_samples, dropped_samples, count);
+
+    for (int i = 0; i < count; i++) {
+        uint32_t key = entries[i].key - 1;
+        uint32_t bank = key >> 16;
+        WORD addr = key & 0xFFFF;
+
+        BYTE code[3];
+        char text[32];
+        read_code(bank, addr, code);
+        disassemble_bytes(addr, code, text, sizeof(text));
+
+        double percent = total_samples ? entries[i].count * 100.0 / total_samples : 0.0;
+
+        if (bank == PROFILE_BANK_NONE) {
+            fprintf(fp, "--:%04X %10u %6.2f%%  %s\n", addr, entries[i].count, percent, text);
+        } else {
+            fprintf(fp, "%02X:%04X %10u %6.2f%%  %s\n", bank, addr, entries[i].count, percent, text);
+        }
+    }
+}
+
+int profiler_dump_file(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "error cannot open profile file: %s!\n", path);
+        return -1;
+    }
+
+    profiler_dump(fp);
+    fclose(fp);
+
+    return 0;
+}
+
+/*
+* 子程序分析器: JSR、NMI、IRQ 和 BRK 进入时压一个影子栈帧, 记下压栈之后的 SP,
+* RTS/RTI 时当前 SP 和栈顶帧相同就是正常返回. 游戏用 PLA 丢掉返回地址、或者压入地址再 RTS 当跳转用,
+* 所以比当前 SP 更深的帧都当作已经返回, 找不到对应帧的 RTS 不算返回.
+* 每个节点是一条调用路径, 同时维护这一帧的树和累计的树, 每帧结束时写出这一帧的树.
+*/
+#define CALL_TREE_SIZE (0x2000)
+#define CALL_STACK_SIZE (0x100)
+
+typedef struct
+{
+    WORD routine;
+    BYTE kind;
+    int parent;
+    int child;   // 第一个子节点, -1 表示没有
+    int sibling; // 下一个兄弟节点
+    uint64_t calls;
+    uint64_t inclusive;
+    uint64_t exclusive;
+}CALL_NODE;
+
+typedef struct
+{
+    CALL_NODE nodes[CALL_TREE_SIZE];
+    int count;
+}CALL_TREE;
+
+typedef struct
+{
+    WORD routine;
+    BYTE kind;
+    BYTE sp;               // 压完返回地址之后的 SP
+    uint64_t start_cycle;
+    uint64_t child_cycles; // 已经返回的子调用花掉的周期
+    int frame_node;
+    int total_node;
+}CALL_FRAME;
+
+BYTE call_profile_enabled = 0;
+
+static CALL_TREE frame_tree, total_tree;
+static CALL_FRAME call_stack[CALL_STACK_SIZE]; // call_stack[0] 是根, 不会返回
+static int call_depth = 0;
+static uint64_t call_frame_index = 0;
+static FILE *call_frame_fp = NULL;
+
+static void call_tree_reset(CALL_TREE *tree)
+{
+    CALL_NODE *root = &tree->nodes[0];
+
+    memset(root, 0, sizeof(CALL_NODE));
+    root->kind = CALL_ROOT;
+    root->parent = -1;
+    root->child = -1;
+    root->sibling = -1;
+
+    tree->count = 1;
+}
+
+// 找到 parent 下面的子节点, 没有就新建; 表满了就记到 parent 上
+static int call_tree_child(CALL_TREE *tree, int parent, WORD routine, BYTE kind)
+{
+    for (int i = tree->nodes[parent].child; i >= 0; i = tree->nodes[i].sibling) {
+        if (tree->nodes[i].routine == routine && tree->nodes[i].kind == kind) {
+            return i;
+        }
+    }
+
+    if (tree->count == CALL_TREE_SIZE) {
+        return parent;
+    }
+
+    int index = tree->count++;
+    CALL_NODE *node = &tree->nodes[index];
+
+    memset(node, 0, sizeof(CALL_NODE));
+    node->routine = routine;
+    node->kind = kind;
+    node->parent = parent;
+    node->child = -1;
+    node->sibling = tree->nodes[parent].child;
+    tree->nodes[parent].child = index;
+
+    return index;
+}
+
+// 把栈帧从开始到现在的周期记到两棵树上
+static uint64_t call_frame_account(CALL_FRAME *frame)
+{
+    // 重新加载 rom 后周期数会从头开始
+    uint64_t elapsed = cpu.cycle > frame->start_cycle ? cpu.cycle - frame->start_cycle : 0;
+    uint64_t exclusive = elapsed > frame->child_cycles ? elapsed - frame->child_cycles : 0;
+
+    frame_tree.nodes[frame->frame_node].inclusive += elapsed;
+    frame_tree.nodes[frame->frame_node].exclusive += exclusive;
+    total_tree.nodes[frame->total_node].inclusive += elapsed;
+    total_tree.nodes[frame->total_node].exclusive += exclusive;
+
+    return elapsed;
+}
+
+static void call_stack_pop()
+{
+    uint64_t elapsed = call_frame_account(&call_stack[call_depth]);
+
+    call_depth--;
+    call_stack[call_depth].child_cycles += elapsed;
+}
+
+void call_profiler_enter(WORD routine, BYTE kind)
+{
+    // 嵌套太深的调用记在当前帧上
+    if (call_depth == CALL_STACK_SIZE - 1) {
+        return;
+    }
+
+    CALL_FRAME *parent = &call_stack[call_depth];
+    CALL_FRAME *frame = &call_stack[++call_depth];
+
+    frame->routine = routine;
+    frame->kind = kind;
+    frame->sp = cpu.SP;
+    frame->start_cycle = cpu.cycle;
+    frame->child_cycles = 0;
+    frame->frame_node = call_tree_child(&frame_tree, parent->frame_node, routine, kind);
+    frame->total_node = call_tree_child(&total_tree, parent->total_node, routine, kind);
+
+    frame_tree.nodes[frame->frame_node].calls++;
+    total_tree.nodes[frame->total_node].calls++;
+}
+
+// RTS/RTI 在弹出返回地址之前调用
+void call_profiler_return()
+{
+    // 返回地址已经被丢掉的帧
+    while (call_depth > 0 && call_stack[call_depth].sp < cpu.SP) {
+        call_stack_pop();
+    }
+
+    if (call_depth > 0 && call_stack[call_depth].sp == cpu.SP) {
+        call_stack_pop();
+    }
+}
+
+static const char *call_kind_name(BYTE kind)
+{
+    switch (kind) {
+        case CALL_NMI: return "NMI ";
+        case CALL_IRQ: return "IRQ ";
+        case CALL_BRK: return "BRK ";
+        default: return "";
+    }
+}
+
+static void call_tree_print(FILE *fp, const CALL_TREE *tree, int index, int depth)
+{
+    const CALL_NODE *node = &tree->nodes[index];
+
+    if (!node->inclusive && !node->calls) {
+        return;
+    }
+
+    fprintf(fp, "%10" PRIu64 " %12" PRIu64 " %12" PRIu64 "  %*s", node->calls, node->inclusive, node->exclusive, depth * 2, "");
+    if (node->kind == CALL_ROOT) {
+        fprintf(fp, "root\n");
+    } else {
+        fprintf(fp, "%s$%04X\n", call_kind_name(node->kind), node->routine);
+    }
+
+    for (int i = node->child; i >= 0; i = tree->nodes[i].sibling) {
+        call_tree_print(fp, tree, i, depth + 1);
+    }
+}
+
+static void call_tree_dump(FILE *fp, const CALL_TREE *tree)
+{
+    fprintf(fp, "     calls    inclusive    exclusive  routine\n");
+    call_tree_print(fp, tree, 0, 0);
+}
+
+// 还没返回的帧先把到现在为止的周期记上, 再从现在开始重新计时
+static void call_stack_split()
+{
+    for (int i = call_depth; i >= 0; i--) {
+        uint64_t elapsed = call_frame_account(&call_stack[i]);
+        if (i > 0) {
+            call_stack[i - 1].child_cycles += elapsed;
+        }
+    }
+
+    for (int i = 0; i <= call_depth; i++) {
+        call_stack[i].start_cycle = cpu.cycle;
+        call_stack[i].child_cycles = 0;
+    }
+}
+
+void call_profiler_start(FILE *frame_fp)
+{
+    call_tree_reset(&frame_tree);
+    call_tree_reset(&total_tree);
+
+    memset(&call_stack[0], 0, sizeof(CALL_FRAME));
+    call_stack[0].start_cycle = cpu.cycle;
+    call_depth = 0;
+
+    call_frame_index = 0;
+    call_frame_fp = frame_fp;
+    call_profile_enabled = 1;
+}
+
+void call_profiler_stop()
+{
+    call_profile_enabled = 0;
+}
+
+// 一帧结束: 写出这一帧的调用树, 然后为还没返回的调用重建新一帧的路径
+void call_profiler_frame()
+{
+    call_stack_split();
+
+    if (call_frame_fp) {
+        fprintf(call_frame_fp, "frame %" PRIu64 "\n", call_frame_index);
+        call_tree_dump(call_frame_fp, &frame_tree);
+    }
+
+    call_frame_index++;
+    call_tree_reset(&frame_tree);
+
+    for (int i = 1; i <= call_depth; i++) {
+        call_stack[i].frame_node = call_tree_child(&frame_tree, call_stack[i - 1].frame_node,
+            call_stack[i].routine, call_stack[i].kind);
+    }
+}
+
+// 输出累计的调用树
+void call_profiler_dump(FILE *fp)
+{
+    call_stack_split();
+
+    fprintf(fp, "total (%" PRIu64 " frames)\n", call_frame_index);
+    call_tree_dump(fp, &total_tree);
+}
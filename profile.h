@@ -0,0 +1,32 @@
+#ifndef __PROFILE_HEADER__
+#define __PROFILE_HEADER__
+#include "common.h"
+
+// 默认每 1000 个 cpu 周期采样一次
+#define PROFILE_DEFAULT_PERIOD (1000)
+
+void profiler_start(uint32_t period);
+void profiler_stop();
+void profiler_sample();
+void profiler_dump(FILE *fp);
+int profiler_dump_file(const char *path);
+
+// 子程序分析器: 跟踪 JSR/RTS、中断和 RTI, 统计每个子程序的包含/不包含子调用的周期数
+enum {
+    CALL_ROOT = 0,
+    CALL_JSR,
+    CALL_NMI,
+    CALL_IRQ,
+    CALL_BRK,
+};
+
+extern BYTE call_profile_enabled;
+
+void call_profiler_start(FILE *frame_fp);
+void call_profiler_stop();
+void call_profiler_enter(WORD routine, BYTE kind);
+void call_profiler_return();
+void call_profiler_frame();
+void call_profiler_dump(FILE *fp);
+
+#endif
@@ -0,0 +1,215 @@
+/*
+* CPU 微基准测试: 为每一组指令生成一个合成的 PRG-ROM (mapper 0, 32KB),
+* 循环体是同一段指令重复 BODY_REPEAT 次, 末尾 JMP 回到循环开始.
+* 不打开窗口和音频设备, 用 cpu_run 执行固定的周期数, 输出每条模拟指令、每个模拟周期花费的纳秒.
+*
+* 用法: bench.exe [每项的周期数], 默认 20000000
+* 输出 CSV: name,group,instructions,cycles,ns_per_instruction,ns_per_cycle
+*/
+#include <time.h>
+#include "../common.h"
+#include "../cpu.h"
+#include "../memory.h"
+#include "../mapper.h"
+#include "../load_rom.h"
+
+#define BODY_REPEAT (64)
+#define DEFAULT_CYCLES (20000000)
+
+#define PRG_SIZE (PRG_ROM_PAGE_SIZE * 2)
+#define SETUP_ADDR (0x8000)
+#define SUB_ADDR (0xF000)  // JSR 的目标, 只有一条 RTS
+#define RTI_ADDR (0xF100)  // NMI/IRQ 向量
+
+#define MAX_CODE (4)
+
+typedef struct
+{
+    const char *name;
+    const char *group;
+    BYTE code[MAX_CODE]; // 循环体里重复的指令
+    BYTE len;
+}BENCH_CASE;
+
+/*
+* 所有测试共用的初始化: X = Y = 1, A = 1, Z 清零,
+* $0F/$10 和 $10/$11 都指向 $0200, 供 (zp,X)、(zp),Y 使用
+*/
+static const BYTE setup_code[] = {
+    0xA9, 0x00,       // LDA #$00
+    0x85, 0x10,       // STA $10
+    0x85, 0x0F,       // STA $0F
+    0xA9, 0x02,       // LDA #$02
+    0x85, 0x11,       // STA $11
+    0xA2, 0x01,       // LDX #$01
+    0xA0, 0x01,       // LDY #$01
+    0xA9, 0x01,       // LDA #$01
+    0x78,             // SEI
+    0xD8,             // CLD
+};
+
+static const BENCH_CASE cases[] = {
+    { "ADC_imm",        "alu",        { 0x69, 0x01 }, 2 },
+    { "ADC_zp",         "alu",        { 0x65, 0x10 }, 2 },
+    { "ADC_zpx",        "alu",        { 0x75, 0x10 }, 2 },
+    { "ADC_abs",        "alu",        { 0x6D, 0x00, 0x02 }, 3 },
+    { "ADC_absx",       "alu",        { 0x7D, 0x00, 0x02 }, 3 },
+    { "ADC_absy",       "alu",        { 0x79, 0x00, 0x02 }, 3 },
+    { "ADC_izx",        "alu",        { 0x61, 0x0F }, 2 },
+    { "ADC_izy",        "alu",        { 0x71, 0x10 }, 2 },
+    { "AND_imm",        "alu",        { 0x29, 0xFF }, 2 },
+    { "CMP_zp",         "alu",        { 0xC5, 0x10 }, 2 },
+    { "LDA_imm",        "load",       { 0xA9, 0x01 }, 2 },
+    { "LDA_zp",         "load",       { 0xA5, 0x10 }, 2 },
+    { "LDA_abs",        "load",       { 0xAD, 0x00, 0x02 }, 3 },
+    { "LDA_rom",        "load",       { 0xAD, 0x00, 0x80 }, 3 },
+    { "LDA_absx_cross", "load",       { 0xBD, 0xFF, 0x02 }, 3 },
+    { "STA_zp",         "store",      { 0x85, 0x20 }, 2 },
+    { "STA_abs",        "store",      { 0x8D, 0x00, 0x03 }, 3 },
+    { "STA_absx",       "store",      { 0x9D, 0x00, 0x03 }, 3 },
+    { "STA_izy",        "store",      { 0x91, 0x10 }, 2 },
+    { "INC_zp",         "rmw",        { 0xE6, 0x20 }, 2 },
+    { "ASL_abs",        "rmw",        { 0x0E, 0x00, 0x03 }, 3 },
+    { "INC_absx",       "rmw",        { 0xFE, 0x00, 0x03 }, 3 },
+    { "ROL_acc",        "rmw",        { 0x2A }, 1 },
+    { "INX",            "implied",    { 0xE8 }, 1 },
+    { "TAX",            "implied",    { 0xAA }, 1 },
+    { "NOP",            "implied",    { 0xEA }, 1 },
+    { "CLC",            "implied",    { 0x18 }, 1 },
+    { "BNE_taken",      "branch",     { 0xD0, 0x00 }, 2 },
+    { "BEQ_not_taken",  "branch",     { 0xF0, 0x00 }, 2 },
+    { "PHA_PLA",        "stack",      { 0x48, 0x68 }, 2 },
+    { "PHP_PLP",        "stack",      { 0x08, 0x28 }, 2 },
+    { "JSR_RTS",        "stack",      { 0x20, SUB_ADDR & 0xFF, SUB_ADDR >> 8 }, 3 },
+    { "LAX_zp",         "unofficial", { 0xA7, 0x10 }, 2 },
+    { "SAX_zp",         "unofficial", { 0x87, 0x20 }, 2 },
+    { "DCP_zp",         "unofficial", { 0xC7, 0x20 }, 2 },
+    { "ISC_abs",        "unofficial", { 0xEF, 0x00, 0x03 }, 3 },
+    { "SLO_izy",        "unofficial", { 0x13, 0x10 }, 2 },
+    { "DOP_zp",         "unofficial", { 0x04, 0x10 }, 2 },
+};
+
+static BYTE *prg = NULL;
+
+static void write_vector(WORD address, WORD target)
+{
+    prg[address - 0x8000] = target & 0xFF;
+    prg[address - 0x8000 + 1] = target >> 8;
+}
+
+// 生成这一项的 PRG-ROM, 返回循环开始的地址
+static WORD build_prg(const BENCH_CASE *bench)
+{
+    memset(prg, 0xEA, PRG_SIZE);
+
+    WORD addr = SETUP_ADDR;
+    memcpy(prg + addr - 0x8000, setup_code, sizeof(setup_code));
+    addr += sizeof(setup_code);
+
+    WORD loop = addr;
+    for (int i = 0; i < BODY_REPEAT; i++) {
+        memcpy(prg + addr - 0x8000, bench->code, bench->len);
+        addr += bench->len;
+    }
+
+    // JMP loop
+    prg[addr - 0x8000] = 0x4C;
+    prg[addr - 0x8000 + 1] = loop & 0xFF;
+    prg[addr - 0x8000 + 2] = loop >> 8;
+
+    prg[SUB_ADDR - 0x8000] = 0x60; // RTS
+    prg[RTI_ADDR - 0x8000] = 0x40; // RTI
+
+    write_vector(0xFFFA, RTI_ADDR);
+    write_vector(0xFFFC, SETUP_ADDR);
+    write_vector(0xFFFE, RTI_ADDR);
+
+    return loop;
+}
+
+static ROM *make_bench_rom()
+{
+    ROM *rom = make_rom();
+    ROM_HEADER *header = calloc(1, sizeof(ROM_HEADER));
+    BYTE *body = calloc(PRG_SIZE + CHR_ROM_PAGE_SIZE, 1);
+    if (!rom || !header || !body) {
+        fprintf(stderr, "alloc bench rom failed!\n");
+        exit(-1);
+    }
+
+    header->version = 1;
+    header->prg_rom_count = PRG_SIZE / PRG_ROM_PAGE_SIZE;
+    header->chr_rom_count = 1;
+    header->mapper_number = 0;
+
+    rom->header = header;
+    rom->body = body;
+    rom->prg_rom = body;
+    rom->chr_rom = body + PRG_SIZE;
+
+    return rom;
+}
+
+// 每一项都重新初始化, 预解码缓存和 jit 的代码都从头开始
+static void bench_init()
+{
+    bus_init_page_cache();
+    mapper_init();
+
+    apu_init();
+    cpu_init();
+    ppu_init();
+}
+
+static void run_case(const BENCH_CASE *bench, uint32_t cycles)
+{
+    WORD loop = build_prg(bench);
+    bench_init();
+
+    // 先单步走完初始化和一整圈, 得到每一圈的指令数和周期数
+    while (PC != loop) {
+        step_cpu();
+    }
+
+    uint64_t pass_instructions = 0, pass_cycles = 0;
+    do {
+        pass_cycles += step_cpu();
+        pass_instructions++;
+    } while (PC != loop);
+
+    clock_t start = clock();
+    uint64_t run_cycles = cpu_run(cycles);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    uint64_t instructions = run_cycles * pass_instructions / pass_cycles;
+    double ns = seconds * 1e9;
+
+    printf("%s,%s,%" PRIu64 ",%" PRIu64 ",%.3f,%.3f\n", bench->name, bench->group,
+        instructions, run_cycles, instructions ? ns / instructions : 0.0, run_cycles ? ns / run_cycles : 0.0);
+}
+
+#undef main
+int main(int argc, char *argv[])
+{
+    uint32_t cycles = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_CYCLES;
+    if (!cycles) {
+        fprintf(stderr, "usage: %s [cycles]\n", argv[0]);
+        return -1;
+    }
+
+    ROM *rom = make_bench_rom();
+    prg = rom->prg_rom;
+    set_current_rom(rom);
+
+    printf("name,group,instructions,cycles,ns_per_instruction,ns_per_cycle\n");
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        run_case(&cases[i], cycles);
+    }
+
+    FREE(rom->header);
+    FREE(rom->body);
+    FREE(rom);
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/*
+* 不带窗口的 CPU 自检: 为每一项生成一个合成的 PRG-ROM (mapper 0, 16KB, 在 $C000 有镜像),
+* 分别全速执行 (会跳过空转循环、成批执行, 打开 jit 时还会走本地代码) 和逐条执行,
+* 每隔 SAMPLE_CYCLES 个周期停一次, 两边停下来时的寄存器、周期数和内部 RAM 必须完全一致.
+*
+* 用法: cputest.exe, 全部一致时返回 0
+*/
+#include "../common.h"
+#include "../cpu.h"
+#include "../memory.h"
+#include "../mapper.h"
+#include "../load_rom.h"
+#include "../debugger.h"
+
+#define PRG_SIZE (PRG_ROM_PAGE_SIZE)
+#define RESET_ADDR (0x8000)
+#define RTI_ADDR (0xBF00)  // NMI/IRQ 向量
+
+#define SAMPLE_CYCLES (997) // 和循环的周期互质, 停下来的位置落在循环里的每一处
+#define SAMPLE_COUNT (120)
+
+#define MAX_PATCHES (4)
+#define MAX_CODE (8)
+
+// 写到 PRG-ROM 里的一段代码
+typedef struct
+{
+    WORD address;
+    BYTE code[MAX_CODE];
+    BYTE len;
+}CODE_PATCH;
+
+typedef struct
+{
+    const char *name;
+    CODE_PATCH patches[MAX_PATCHES]; // 从 RESET_ADDR 开始执行
+    BYTE count;
+}TEST_CASE;
+
+typedef struct
+{
+    WORD pc;
+    BYTE a, x, y, p, sp;
+    uint64_t cycle;
+    BYTE ram[CPU_RAM_SIZE];
+}SNAPSHOT;
+
+static const TEST_CASE cases[] = {
+    // 每圈 6 个周期的空转循环, 跳过以后还要停在 13 + 6k 这样的边界上
+    { "idle_lda_zp_beq", {
+        { 0x8000, { 0xA9, 0x00,         // LDA #$00
+                    0x85, 0x10,         // STA $10
+                    0xA5, 0x10,         // LDA $10
+                    0xF0, 0xFC }, 8 },  // BEQ $8004
+    }, 1 },
+
+    // 循环末尾的跳转跨页, 每圈 3 + 2 + 4 个周期
+    { "idle_branch_page_cross", {
+        { 0x8000, { 0xA9, 0x01,         // LDA #$01
+                    0x85, 0x10,         // STA $10
+                    0x4C, 0xFB, 0x80 }, 7 }, // JMP $80FB
+        { 0x80FB, { 0xA5, 0x10,         // LDA $10
+                    0xC9, 0x02,         // CMP #$02
+                    0xD0, 0xFA }, 6 },  // BNE $80FB
+    }, 2 },
+
+    // 绝对地址读 RAM 再比较, 用 BCC 结束
+    { "idle_lda_abs_bcc", {
+        { 0x8000, { 0xAD, 0x10, 0x02,   // LDA $0210
+                    0xC9, 0x04,         // CMP #$04
+                    0x90, 0xF9 }, 7 },  // BCC $8000
+    }, 1 },
+
+    // 只有一条跳到自己的 JMP
+    { "idle_jmp_self", {
+        { 0x8000, { 0xEA,               // NOP
+                    0x4C, 0x01, 0x80 }, 4 }, // JMP $8001
+    }, 1 },
+
+    // 同一段 ROM 先在 $8002 执行到编译成 jit 块, 再从 $C002 的镜像执行, 块里的 PC 不能还是 $80xx
+    { "mirror_alias", {
+        { 0x8000, { 0xA2, 0x00,         // LDX #$00
+                    0xE6, 0x10,         // INC $10
+                    0xE8,               // INX
+                    0xD0, 0xFB }, 7 },  // BNE $8002 / $C002
+        { 0x8007, { 0x4C, 0x02, 0xC0 }, 3 }, // JMP $C002
+    }, 2 },
+};
+
+static BYTE *prg = NULL;
+
+// 16KB 的 PRG-ROM 在 $8000 和 $C000 各映射一次
+static inline BYTE *prg_at(WORD address)
+{
+    return prg + (address & (PRG_SIZE - 1));
+}
+
+static void write_vector(WORD address, WORD target)
+{
+    prg_at(address)[0] = target & 0xFF;
+    prg_at(address)[1] = target >> 8;
+}
+
+static void build_prg(const TEST_CASE *test)
+{
+    memset(prg, 0xEA, PRG_SIZE);
+
+    for (int i = 0; i < test->count; i++) {
+        const CODE_PATCH *patch = &test->patches[i];
+        memcpy(prg_at(patch->address), patch->code, patch->len);
+    }
+
+    *prg_at(RTI_ADDR) = 0x40; // RTI
+
+    write_vector(0xFFFA, RTI_ADDR);
+    write_vector(0xFFFC, RESET_ADDR);
+    write_vector(0xFFFE, RTI_ADDR);
+}
+
+static ROM *make_test_rom()
+{
+    ROM *rom = make_rom();
+    ROM_HEADER *header = calloc(1, sizeof(ROM_HEADER));
+    BYTE *body = calloc(PRG_SIZE + CHR_ROM_PAGE_SIZE, 1);
+    if (!rom || !header || !body) {
+        fprintf(stderr, "alloc test rom failed!\n");
+        exit(-1);
+    }
+
+    header->version = 1;
+    header->prg_rom_count = PRG_SIZE / PRG_ROM_PAGE_SIZE;
+    header->chr_rom_count = 1;
+    header->mapper_number = 0;
+
+    rom->header = header;
+    rom->body = body;
+    rom->prg_rom = body;
+    rom->chr_rom = body + PRG_SIZE;
+
+    return rom;
+}
+
+// 每一遍都重新初始化, 预解码缓存、空转循环的记录和 jit 的代码都从头开始
+static void test_init()
+{
+    bus_init_page_cache();
+    mapper_init();
+
+    apu_init();
+    cpu_init();
+    ppu_init();
+
+    memset(cpu.ram, 0, CPU_RAM_SIZE);
+}
+
+static void take_snapshot(SNAPSHOT *snapshot)
+{
+    snapshot->pc = PC;
+    snapshot->a = cpu.A;
+    snapshot->x = cpu.X;
+    snapshot->y = cpu.Y;
+    snapshot->p = cpu_get_status();
+    snapshot->sp = cpu.SP;
+    snapshot->cycle = cpu.cycle;
+    memcpy(snapshot->ram, cpu.ram, CPU_RAM_SIZE);
+}
+
+static int same_snapshot(const SNAPSHOT *a, const SNAPSHOT *b)
+{
+    return a->pc == b->pc && a->a == b->a && a->x == b->x && a->y == b->y && a->p == b->p &&
+           a->sp == b->sp && a->cycle == b->cycle && !memcmp(a->ram, b->ram, CPU_RAM_SIZE);
+}
+
+/*
+* 执行一遍, 每隔 SAMPLE_CYCLES 记一次状态.
+* 逐条执行时在执行不到的 $FFFF 上设一个执行断点, cpu 就不走 jit, 不成批执行也不跳过空转循环
+*/
+static void run_samples(SNAPSHOT *samples, int step_each)
+{
+    test_init();
+
+    if (step_each) {
+        debug_add_point(DEBUG_EXEC, 0xFFFF, 0xFFFF, NULL);
+    }
+
+    uint64_t start = cpu.cycle;
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        cpu_run_until(start + (uint64_t)(i + 1) * SAMPLE_CYCLES);
+        take_snapshot(&samples[i]);
+    }
+
+    debug_clear_points();
+}
+
+static void print_snapshot(const char *label, const SNAPSHOT *snapshot)
+{
+    fprintf(stderr, "  %s PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%" PRIu64 "\n", label,
+        snapshot->pc, snapshot->a, snapshot->x, snapshot->y, snapshot->p, snapshot->sp, snapshot->cycle);
+}
+
+static int run_case(const TEST_CASE *test)
+{
+    static SNAPSHOT fast[SAMPLE_COUNT], stepped[SAMPLE_COUNT];
+
+    build_prg(test);
+    run_samples(fast, 0);
+    run_samples(stepped, 1);
+
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        if (!same_snapshot(&fast[i], &stepped[i])) {
+            fprintf(stderr, "%s: mismatch at sample %d\n", test->name, i + 1);
+            print_snapshot("fast:   ", &fast[i]);
+            print_snapshot("stepped:", &stepped[i]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+#undef main
+int main(int argc, char *argv[])
+{
+    ROM *rom = make_test_rom();
+    prg = rom->prg_rom;
+    set_current_rom(rom);
+
+    int count = sizeof(cases) / sizeof(cases[0]);
+    int passed = 0;
+
+    for (int i = 0; i < count; i++) {
+        passed += run_case(&cases[i]);
+    }
+
+    printf("%d/%d cases matched\n", passed, count);
+
+    FREE(rom->header);
+    FREE(rom->body);
+    FREE(rom);
+
+    return passed == count ? 0 : 1;
+}
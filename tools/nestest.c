@@ -0,0 +1,210 @@
+/*
+* 不带窗口的 CPU 一致性测试: 以 automation 模式($C000 开始) 运行 nestest,
+* 每条指令执行前把 PC、A、X、Y、P、SP 和周期数与 nestest.log 对比,
+* 遇到第一处不一致就打印前后几行然后退出, 全部一致时打印每秒执行的指令数.
+*
+* 用法: nestest.exe [-r] [rom] [log], 默认 test.nes 和 nestest.log
+* -r 只对比寄存器, 不对比周期数
+*/
+#include <time.h>
+#include "../common.h"
+#include "../cpu.h"
+#include "../memory.h"
+#include "../mapper.h"
+#include "../load_rom.h"
+
+#define CONTEXT_LINES (5)
+
+typedef struct
+{
+    WORD pc;
+    BYTE a, x, y, p, sp;
+    uint64_t cycle;
+    char *text; // 原始的一行, 出错时打印
+}LOG_LINE;
+
+static LOG_LINE *log_lines = NULL;
+static int log_count = 0;
+static int compare_cycle = 1;
+
+// 从一行里找到 "name:" 后面的数值
+static int parse_field(const char *line, const char *name, int base, unsigned long long *value)
+{
+    const char *pos = strstr(line, name);
+    if (!pos) {
+        return 0;
+    }
+
+    char *end = NULL;
+    *value = strtoull(pos + strlen(name), &end, base);
+
+    return end != pos + strlen(name);
+}
+
+static int parse_line(char *line, LOG_LINE *entry)
+{
+    unsigned long long pc, a, x, y, p, sp, cycle;
+
+    pc = strtoul(line, NULL, 16);
+    if (!parse_field(line, "A:", 16, &a) || !parse_field(line, "X:", 16, &x) ||
+        !parse_field(line, "Y:", 16, &y) || !parse_field(line, "P:", 16, &p) ||
+        !parse_field(line, "SP:", 16, &sp) || !parse_field(line, "CYC:", 10, &cycle)) {
+        return 0;
+    }
+
+    entry->pc = pc;
+    entry->a = a;
+    entry->x = x;
+    entry->y = y;
+    entry->p = p;
+    entry->sp = sp;
+    entry->cycle = cycle;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    entry->text = malloc(strlen(line) + 1);
+    if (!entry->text) {
+        return 0;
+    }
+    strcpy(entry->text, line);
+
+    return 1;
+}
+
+// 整个日志一次读进内存, 运行时不再做文件 IO
+static void load_log(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "error cannot open log file: %s!\n", path);
+        exit(-1);
+    }
+
+    int capacity = 0x4000;
+    log_lines = malloc(capacity * sizeof(LOG_LINE));
+
+    char line[256];
+    while (log_lines && fgets(line, sizeof(line), fp)) {
+        if (log_count == capacity) {
+            capacity *= 2;
+            log_lines = realloc(log_lines, capacity * sizeof(LOG_LINE));
+            if (!log_lines) {
+                break;
+            }
+        }
+
+        if (!parse_line(line, &log_lines[log_count])) {
+            fprintf(stderr, "parse log %s line %d failed!\n", path, log_count + 1);
+            exit(-1);
+        }
+
+        log_count++;
+    }
+
+    fclose(fp);
+
+    if (!log_lines) {
+        fprintf(stderr, "alloc log lines failed!\n");
+        exit(-1);
+    }
+}
+
+static void release_log()
+{
+    for (int i = 0; i < log_count; i++) {
+        FREE(log_lines[i].text);
+    }
+
+    FREE(log_lines);
+}
+
+static int match_line(const LOG_LINE *entry)
+{
+    return PC == entry->pc && cpu.A == entry->a && cpu.X == entry->x && cpu.Y == entry->y &&
+           cpu_get_status() == entry->p && cpu.SP == entry->sp && (!compare_cycle || cpu.cycle == entry->cycle);
+}
+
+static void report_mismatch(int index)
+{
+    const LOG_LINE *entry = &log_lines[index];
+
+    fprintf(stderr, "mismatch at line %d:\n", index + 1);
+
+    int first = index > CONTEXT_LINES ? index - CONTEXT_LINES : 0;
+    for (int i = first; i <= index; i++) {
+        fprintf(stderr, "  %6d %s\n", i + 1, log_lines[i].text);
+    }
+
+    fprintf(stderr, "  expect PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%" PRIu64 "\n",
+        entry->pc, entry->a, entry->x, entry->y, entry->p, entry->sp, entry->cycle);
+    fprintf(stderr, "  actual PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%" PRIu64 "\n",
+        PC, cpu.A, cpu.X, cpu.Y, cpu_get_status(), cpu.SP, cpu.cycle);
+}
+
+// 和 fc_init 一样初始化, 但不打开窗口和音频设备, ppu 没有渲染器时不会运行
+static void nestest_init(const char *rom_path)
+{
+    ROM *rom = load_rom(rom_path);
+    if (!rom) {
+        exit(-1);
+    }
+
+    set_current_rom(rom);
+    bus_init_page_cache();
+
+    mapper_init();
+
+    apu_init();
+    cpu_init();
+    ppu_init();
+
+    // automation 模式的初始状态
+    PC = 0xC000;
+    cpu.SP = 0xFD;
+    cpu_set_status(0x24);
+    cpu.cycle = 7;
+}
+
+#undef main
+int main(int argc, char *argv[])
+{
+    int arg = 1;
+    if (argc > arg && !strcmp(argv[arg], "-r")) {
+        compare_cycle = 0;
+        arg++;
+    }
+
+    const char *rom_path = argc > arg ? argv[arg] : "test.nes";
+    const char *log_path = argc > arg + 1 ? argv[arg + 1] : "nestest.log";
+
+    load_log(log_path);
+    nestest_init(rom_path);
+
+    clock_t start = clock();
+
+    int i;
+    for (i = 0; i < log_count; i++) {
+        if (!match_line(&log_lines[i])) {
+            break;
+        }
+
+        step_cpu();
+    }
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    int result = 0;
+    if (i < log_count) {
+        report_mismatch(i);
+        result = 1;
+    }
+
+    printf("%d/%d instructions matched, %.3f s", i, log_count, seconds);
+    if (seconds > 0) {
+        printf(", %.0f instructions/s", i / seconds);
+    }
+    printf("\n");
+
+    release_log();
+
+    return result;
+}
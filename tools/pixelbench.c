@@ -0,0 +1,133 @@
+/*
+* ppu 像素处理函数的微基准测试: 对每组 cpu 支持的实现, 反复展开一整条扫描线的位平面(32 个图块)
+* 和查表转换一整帧的颜色索引, 先检查结果和普通 C 的版本一致, 再输出每个像素花费的纳秒.
+*
+* 用法: pixelbench.exe [每项的轮数], 默认 2000
+* 输出 CSV: kernel,operation,pixels,ns_per_pixel,speedup
+*/
+#include <time.h>
+#include "../common.h"
+#include "../pixel.h"
+
+#define DEFAULT_ROUNDS (2000)
+#define LINE_TILES (SCREEN_WIDTH / 8)
+#define FRAME_PIXELS (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+extern uint32_t rgb_palette[64];
+
+static BYTE lsb[LINE_TILES];
+static BYTE msb[LINE_TILES];
+static BYTE indices[FRAME_PIXELS];
+
+static BYTE expected_pixels[SCREEN_WIDTH];
+static uint32_t expected_colors[FRAME_PIXELS];
+
+static BYTE pixels[SCREEN_WIDTH];
+static uint32_t colors[FRAME_PIXELS];
+
+// 固定种子的伪随机数, 每次运行的输入都一样
+static uint32_t next_random()
+{
+    static uint32_t seed = 0x12345678;
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static double bench_expand(const PIXEL_KERNELS *kernels, int rounds)
+{
+    clock_t start = clock();
+
+    // 展开一整帧: 每条扫描线 32 个图块
+    for (int round = 0; round < rounds; round++) {
+        for (int line = 0; line < SCREEN_HEIGHT; line++) {
+            kernels->expand_planes(lsb, msb, LINE_TILES, pixels);
+        }
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double bench_lookup(const PIXEL_KERNELS *kernels, int rounds)
+{
+    clock_t start = clock();
+
+    for (int round = 0; round < rounds; round++) {
+        kernels->palette_lookup(indices, rgb_palette, FRAME_PIXELS, colors);
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void print_result(const char *kernel, const char *operation, uint64_t count, double seconds, double scalar_seconds)
+{
+    printf("%s,%s,%" PRIu64 ",%.4f,%.2f\n", kernel, operation, count,
+        count ? seconds * 1e9 / count : 0.0, seconds > 0 ? scalar_seconds / seconds : 0.0);
+}
+
+#undef main
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return -1;
+    }
+
+    for (int i = 0; i < LINE_TILES; i++) {
+        lsb[i] = next_random();
+        msb[i] = next_random();
+    }
+
+    for (int i = 0; i < FRAME_PIXELS; i++) {
+        indices[i] = next_random() & 0x3F;
+    }
+
+    // 第一项是普通 C 的版本, 作为对比的基准
+    pixel_kernel_table[0].expand_planes(lsb, msb, LINE_TILES, expected_pixels);
+    pixel_kernel_table[0].palette_lookup(indices, rgb_palette, FRAME_PIXELS, expected_colors);
+
+    uint64_t expand_count = (uint64_t)rounds * SCREEN_HEIGHT * SCREEN_WIDTH;
+    uint64_t lookup_count = (uint64_t)rounds * FRAME_PIXELS;
+    double scalar_expand = 0, scalar_lookup = 0;
+
+    printf("kernel,operation,pixels,ns_per_pixel,speedup\n");
+
+    for (int i = 0; i < pixel_kernel_count; i++) {
+        const PIXEL_KERNELS *kernels = &pixel_kernel_table[i];
+        if (!kernels->supported()) {
+            fprintf(stderr, "%s is not supported by this cpu, skipped\n", kernels->name);
+            continue;
+        }
+
+        // 长度不是整组时会走到剩余部分的处理, 也一起检查
+        for (int count = 0; count <= LINE_TILES; count++) {
+            memset(pixels, 0, sizeof(pixels));
+            kernels->expand_planes(lsb, msb, count, pixels);
+            if (memcmp(pixels, expected_pixels, count * 8)) {
+                fprintf(stderr, "%s expand_planes mismatch, count = %d!\n", kernels->name, count);
+                return -1;
+            }
+        }
+
+        for (int count = FRAME_PIXELS - 33; count <= FRAME_PIXELS; count++) {
+            memset(colors, 0, sizeof(colors));
+            kernels->palette_lookup(indices, rgb_palette, count, colors);
+            if (memcmp(colors, expected_colors, count * sizeof(uint32_t))) {
+                fprintf(stderr, "%s palette_lookup mismatch, count = %d!\n", kernels->name, count);
+                return -1;
+            }
+        }
+
+        double expand = bench_expand(kernels, rounds);
+        double lookup = bench_lookup(kernels, rounds);
+        if (i == 0) {
+            scalar_expand = expand;
+            scalar_lookup = lookup;
+        }
+
+        print_result(kernels->name, "expand_planes", expand_count, expand, scalar_expand);
+        print_result(kernels->name, "palette_lookup", lookup_count, lookup, scalar_lookup);
+    }
+
+    return 0;
+}
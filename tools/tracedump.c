@@ -0,0 +1,56 @@
+/*
+* 把模拟器写出的二进制 cpu 跟踪文件还原成 nestest.log 格式的文本, 输出到标准输出.
+* nestest.log 里内存操作数后面的 "= 值" 没有记录, 不输出
+*
+* 用法: tracedump.exe [trace 文件], 默认 trace.bin
+*/
+#include "../common.h"
+#include "../cpu.h"
+#include "../disasm.h"
+#include "../trace.h"
+
+static void print_record(const TRACE_RECORD *record)
+{
+    BYTE length = code_maps[record->code[0]].op_len;
+    char bytes[16] = {0};
+    char text[32];
+
+    for (int i = 0, pos = 0; i < length && i < 3; i++) {
+        pos += sprintf(bytes + pos, i ? " %02X" : "%02X", record->code[i]);
+    }
+
+    disassemble_bytes(record->pc, record->code, text, sizeof(text));
+
+    printf("%04X  %-8s  %-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%" PRIu64 "\n",
+        record->pc, bytes, text, record->a, record->x, record->y, record->p, record->sp,
+        record->scanline, record->dot, record->cycle);
+}
+
+#undef main
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "trace.bin";
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "error cannot open trace file: %s!\n", path);
+        return -1;
+    }
+
+    if (!trace_open(fp)) {
+        fprintf(stderr, "%s is not a trace file!\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    BYTE prev[TRACE_RECORD_BYTES] = {0};
+    TRACE_RECORD record;
+
+    while (trace_read(fp, prev, &record)) {
+        print_record(&record);
+    }
+
+    fclose(fp);
+
+    return 0;
+}
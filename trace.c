@@ -0,0 +1,247 @@
+#include "trace.h"
+#include "memory.h"
+#include "cpu.h"
+
+/*
+* 环形缓冲区只有一个写入者(模拟线程) 和一个读出者(写文件的线程), head 和 tail 各自只由一方修改, 不需要加锁.
+* 缓冲区满了模拟线程就等一等, 记录不会丢.
+* 压缩: 每条记录和上一条按字节异或, 先写 3 个字节的掩码标出变化了的字节, 再只写这些字节.
+* 相邻两条指令之间通常只有 PC、周期数的低位和一两个寄存器在变, 平均每条只要 8 字节左右
+*/
+#define TRACE_RING_SIZE (0x10000)
+#define TRACE_MASK_BYTES (3)
+#define TRACE_OUTPUT_SIZE (0x10000)
+
+BYTE trace_enabled = 0;
+
+static TRACE_RECORD trace_ring[TRACE_RING_SIZE];
+static SDL_atomic_t trace_head;   // 下一条要写入的位置, 只由模拟线程修改
+static SDL_atomic_t trace_tail;   // 下一条要读出的位置, 只由写文件的线程修改
+static SDL_atomic_t trace_running;
+static uint32_t trace_local_head = 0;
+static uint32_t trace_free_tail = 0; // 模拟线程看到的 tail, 只有缓冲区看起来满了才重新读
+
+static SDL_Thread *trace_thread = NULL;
+static FILE *trace_fp = NULL;
+
+static void trace_serialize(const TRACE_RECORD *record, BYTE bytes[TRACE_RECORD_BYTES])
+{
+    bytes[0] = record->pc & 0xFF;
+    bytes[1] = record->pc >> 8;
+    bytes[2] = record->code[0];
+    bytes[3] = record->code[1];
+    bytes[4] = record->code[2];
+    bytes[5] = record->a;
+    bytes[6] = record->x;
+    bytes[7] = record->y;
+    bytes[8] = record->p;
+    bytes[9] = record->sp;
+    bytes[10] = (WORD)record->scanline & 0xFF;
+    bytes[11] = (WORD)record->scanline >> 8;
+    bytes[12] = record->dot & 0xFF;
+    bytes[13] = record->dot >> 8;
+
+    for (int i = 0; i < 8; i++) {
+        bytes[14 + i] = (record->cycle >> (i * 8)) & 0xFF;
+    }
+}
+
+static void trace_deserialize(const BYTE bytes[TRACE_RECORD_BYTES], TRACE_RECORD *record)
+{
+    record->pc = bytes[0] | (bytes[1] << 8);
+    record->code[0] = bytes[2];
+    record->code[1] = bytes[3];
+    record->code[2] = bytes[4];
+    record->a = bytes[5];
+    record->x = bytes[6];
+    record->y = bytes[7];
+    record->p = bytes[8];
+    record->sp = bytes[9];
+    record->scanline = (int16_t)(bytes[10] | (bytes[11] << 8));
+    record->dot = bytes[12] | (bytes[13] << 8);
+
+    record->cycle = 0;
+    for (int i = 0; i < 8; i++) {
+        record->cycle |= (uint64_t)bytes[14 + i] << (i * 8);
+    }
+}
+
+// 压缩一条记录写到 out, 返回写入的字节数
+static int trace_encode(const TRACE_RECORD *record, BYTE prev[TRACE_RECORD_BYTES], BYTE *out)
+{
+    BYTE bytes[TRACE_RECORD_BYTES];
+    uint32_t mask = 0;
+    int length = TRACE_MASK_BYTES;
+
+    trace_serialize(record, bytes);
+
+    for (int i = 0; i < TRACE_RECORD_BYTES; i++) {
+        if (bytes[i] != prev[i]) {
+            mask |= 1u << i;
+            out[length++] = bytes[i];
+            prev[i] = bytes[i];
+        }
+    }
+
+    out[0] = mask & 0xFF;
+    out[1] = (mask >> 8) & 0xFF;
+    out[2] = (mask >> 16) & 0xFF;
+
+    return length;
+}
+
+// 把环形缓冲区里已有的记录全部写出去, 返回写了多少条
+static uint32_t trace_drain(BYTE prev[TRACE_RECORD_BYTES])
+{
+    static BYTE output[TRACE_OUTPUT_SIZE];
+    int length = 0;
+
+    uint32_t tail = SDL_AtomicGet(&trace_tail);
+    uint32_t head = SDL_AtomicGet(&trace_head);
+    uint32_t count = head - tail;
+
+    for (; tail != head; tail++) {
+        if (length + TRACE_MASK_BYTES + TRACE_RECORD_BYTES > TRACE_OUTPUT_SIZE) {
+            fwrite(output, 1, length, trace_fp);
+            length = 0;
+        }
+
+        length += trace_encode(&trace_ring[tail & (TRACE_RING_SIZE - 1)], prev, output + length);
+
+        // 每编码完一批就让出空间
+        if ((tail & 0xFFF) == 0xFFF) {
+            SDL_AtomicSet(&trace_tail, tail + 1);
+        }
+    }
+
+    fwrite(output, 1, length, trace_fp);
+    SDL_AtomicSet(&trace_tail, tail);
+
+    return count;
+}
+
+static int trace_writer(void *data)
+{
+    BYTE prev[TRACE_RECORD_BYTES] = {0};
+    (void)data;
+
+    while (SDL_AtomicGet(&trace_running)) {
+        if (!trace_drain(prev)) {
+            SDL_Delay(1);
+        }
+    }
+
+    // 停下来以后把剩下的都写出去
+    trace_drain(prev);
+
+    return 0;
+}
+
+int trace_start(const char *path)
+{
+    trace_fp = fopen(path, "wb");
+    if (!trace_fp) {
+        fprintf(stderr, "error cannot open trace file: %s!\n", path);
+        return -1;
+    }
+
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), trace_fp);
+
+    trace_local_head = 0;
+    trace_free_tail = 0;
+    SDL_AtomicSet(&trace_head, 0);
+    SDL_AtomicSet(&trace_tail, 0);
+    SDL_AtomicSet(&trace_running, 1);
+
+    trace_thread = SDL_CreateThread(trace_writer, "trace_writer", NULL);
+    if (!trace_thread) {
+        fprintf(stderr, "trace thread creation failed!\n");
+        fclose(trace_fp);
+        trace_fp = NULL;
+        return -1;
+    }
+
+    trace_enabled = 1;
+
+    return 0;
+}
+
+void trace_stop()
+{
+    if (!trace_thread) {
+        return;
+    }
+
+    trace_enabled = 0;
+
+    SDL_AtomicSet(&trace_running, 0);
+    SDL_WaitThread(trace_thread, NULL);
+    trace_thread = NULL;
+
+    fclose(trace_fp);
+    trace_fp = NULL;
+}
+
+// 在 PC 处的指令执行之前调用, ppu 的位置要先同步到当前周期. 指令字节用 bus_peek 读, 不会触发观察点和 I/O
+void trace_instruction()
+{
+    // 缓冲区满了, 等写文件的线程腾出空间
+    while (trace_local_head - trace_free_tail == TRACE_RING_SIZE) {
+        trace_free_tail = SDL_AtomicGet(&trace_tail);
+        if (trace_local_head - trace_free_tail == TRACE_RING_SIZE) {
+            SDL_Delay(0);
+        }
+    }
+
+    TRACE_RECORD *record = &trace_ring[trace_local_head & (TRACE_RING_SIZE - 1)];
+    BYTE opcode = bus_peek(PC);
+    BYTE length = code_maps[opcode].op_len;
+
+    record->cycle = cpu.cycle;
+    record->pc = PC;
+    record->code[0] = opcode;
+    record->code[1] = length > 1 ? bus_peek(PC + 1) : 0;
+    record->code[2] = length > 2 ? bus_peek(PC + 2) : 0;
+    record->a = cpu.A;
+    record->x = cpu.X;
+    record->y = cpu.Y;
+    record->p = cpu_get_status();
+    record->sp = cpu.SP;
+    record->scanline = ppu.scanline;
+    record->dot = ppu.cycle;
+
+    SDL_AtomicSet(&trace_head, ++trace_local_head);
+}
+
+// 检查文件头
+int trace_open(FILE *fp)
+{
+    char magic[sizeof(TRACE_MAGIC)] = {0};
+
+    return fread(magic, 1, strlen(TRACE_MAGIC), fp) == strlen(TRACE_MAGIC) && !strcmp(magic, TRACE_MAGIC);
+}
+
+int trace_read(FILE *fp, BYTE prev[TRACE_RECORD_BYTES], TRACE_RECORD *record)
+{
+    BYTE mask_bytes[TRACE_MASK_BYTES];
+
+    if (fread(mask_bytes, 1, TRACE_MASK_BYTES, fp) != TRACE_MASK_BYTES) {
+        return 0;
+    }
+
+    uint32_t mask = mask_bytes[0] | (mask_bytes[1] << 8) | (mask_bytes[2] << 16);
+
+    for (int i = 0; i < TRACE_RECORD_BYTES; i++) {
+        if (mask & (1u << i)) {
+            int value = fgetc(fp);
+            if (value == EOF) {
+                return 0;
+            }
+            prev[i] = value;
+        }
+    }
+
+    trace_deserialize(prev, record);
+
+    return 1;
+}
@@ -0,0 +1,32 @@
+#ifndef __TRACE_HEADER__
+#define __TRACE_HEADER__
+#include "common.h"
+
+/*
+* 二进制的 cpu 跟踪: 每条指令执行前记录一条定长的记录, 写进环形缓冲区,
+* 后台线程把缓冲区里的记录压缩后写到文件, 用 tools/tracedump.c 还原成 nestest.log 格式的文本
+*/
+#define TRACE_MAGIC "FCTRACE1"
+#define TRACE_RECORD_BYTES (22) // 序列化之后的长度
+
+typedef struct
+{
+    uint64_t cycle;
+    WORD pc;
+    BYTE code[3];  // 操作码和操作数, 没有用到的字节为 0
+    BYTE a, x, y, p, sp;
+    int16_t scanline;
+    WORD dot;
+}TRACE_RECORD;
+
+extern BYTE trace_enabled;
+
+int trace_start(const char *path);
+void trace_stop();
+void trace_instruction();
+
+// 读出下一条记录, 读完或者文件损坏时返回 0, prev 是上一条记录序列化之后的字节, 开始前清零
+int trace_open(FILE *fp);
+int trace_read(FILE *fp, BYTE prev[TRACE_RECORD_BYTES], TRACE_RECORD *record);
+
+#endif